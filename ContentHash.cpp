@@ -0,0 +1,140 @@
+#include "ContentHash.h"
+#include <cstring>
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotate_left(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const uint8_t *bytes)
+{
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t *bytes)
+{
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// Mix 8 input bytes into one accumulator lane
+static inline uint64_t mix_lane(uint64_t lane, uint64_t input)
+{
+    lane += input * PRIME2;
+    lane = rotate_left(lane, 31);
+    return lane * PRIME1;
+}
+
+static inline uint64_t merge_round(uint64_t hash, uint64_t lane)
+{
+    hash ^= mix_lane(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+// Constructor: empty stream
+ContentHash::ContentHash(uint64_t seed) : pendingBytes(0), totalBytes(0), seed(seed)
+{
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+void ContentHash::update(const void *data, size_t bytes)
+{
+    const uint8_t *input = static_cast<const uint8_t *>(data);
+    const uint8_t *end = input + bytes;
+    totalBytes += bytes;
+
+    // Complete a stripe left over from the previous call first.
+    if (pendingBytes > 0)
+    {
+        size_t room = 32 - static_cast<size_t>(pendingBytes);
+        size_t take = room < bytes ? room : bytes;
+        std::memcpy(pending + pendingBytes, input, take);
+        pendingBytes += static_cast<int>(take);
+        input += take;
+        if (pendingBytes < 32)
+        {
+            return;
+        }
+        for (int lane = 0; lane < 4; lane++)
+        {
+            lanes[lane] = mix_lane(lanes[lane], read64(pending + 8 * lane));
+        }
+        pendingBytes = 0;
+    }
+
+    // Whole stripes straight from the input, four independent lanes at a time
+    uint64_t v0 = lanes[0], v1 = lanes[1], v2 = lanes[2], v3 = lanes[3];
+    for (; end - input >= 32; input += 32)
+    {
+        v0 = mix_lane(v0, read64(input));
+        v1 = mix_lane(v1, read64(input + 8));
+        v2 = mix_lane(v2, read64(input + 16));
+        v3 = mix_lane(v3, read64(input + 24));
+    }
+    lanes[0] = v0;
+    lanes[1] = v1;
+    lanes[2] = v2;
+    lanes[3] = v3;
+
+    std::memcpy(pending, input, end - input);
+    pendingBytes = static_cast<int>(end - input);
+}
+
+uint64_t ContentHash::digest() const
+{
+    uint64_t hash;
+    if (totalBytes >= 32)
+    {
+        hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+               rotate_left(lanes[3], 18);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            hash = merge_round(hash, lanes[lane]);
+        }
+    }
+    else
+    {
+        hash = seed + PRIME5;
+    }
+    hash += totalBytes;
+
+    // Fold in the tail that did not fill a stripe.
+    const uint8_t *tail = pending;
+    const uint8_t *end = pending + pendingBytes;
+    for (; end - tail >= 8; tail += 8)
+    {
+        hash ^= mix_lane(0, read64(tail));
+        hash = rotate_left(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (end - tail >= 4)
+    {
+        hash ^= static_cast<uint64_t>(read32(tail)) * PRIME1;
+        hash = rotate_left(hash, 23) * PRIME2 + PRIME3;
+        tail += 4;
+    }
+    for (; tail < end; tail++)
+    {
+        hash ^= *tail * PRIME5;
+        hash = rotate_left(hash, 11) * PRIME1;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,30 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit XXH64 hash of a byte stream, fed in pieces of any size (e.g. the rows
+// of an image, which are not contiguous). Gives the same values as the
+// reference XXH64 on little-endian machines. Not cryptographic: it tells
+// apart different contents, it does not resist deliberate collisions.
+class ContentHash {
+private:
+    uint64_t lanes[4];
+    uint8_t pending[32]; // bytes not yet forming a full 32-byte stripe
+    int pendingBytes;
+    uint64_t totalBytes;
+    uint64_t seed;
+
+public:
+    // Constructor: empty stream
+    explicit ContentHash(uint64_t seed = 0);
+
+    // Append bytes to the stream
+    void update(const void* data, size_t bytes);
+
+    // Hash of everything appended so far (the stream can still be extended)
+    uint64_t digest() const;
+};
+
+#endif // CONTENT_HASH_H
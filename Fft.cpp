@@ -0,0 +1,184 @@
+#define _USE_MATH_DEFINES
+#include "Fft.h"
+#include <cmath>
+#include <stdexcept>
+
+typedef std::complex<double> Complex;
+
+// Constructor: factor the length and tabulate the twiddle factors
+Fft::Fft(int size) : size(size)
+{
+    if (size < 1 || fast_size(size) != size)
+    {
+        throw std::invalid_argument("ERROR: FFT LENGTH MUST BE OF THE FORM 2^a * 3^b * 5^c.");
+    }
+
+    // Radix 4 wherever possible (the cheapest butterfly per point), with a
+    // single radix 2 for an odd power of two, taken first so that the
+    // innermost transforms stay radix 4; then radix 3 and 5.
+    int remaining = size;
+    int powerOfTwo = 0;
+    while ((remaining >> powerOfTwo) % 2 == 0)
+    {
+        powerOfTwo++;
+    }
+    const int radices[] = {2, 4, 3, 5};
+    for (int r = 0; r < 4; r++)
+    {
+        while (remaining % radices[r] == 0 && (radices[r] != 2 || powerOfTwo % 2 == 1))
+        {
+            remaining /= radices[r];
+            factors.push_back(radices[r]);
+            factors.push_back(remaining);
+            powerOfTwo -= radices[r] == 2 ? 1 : 0;
+        }
+    }
+    if (size == 1)
+    {
+        factors.push_back(1);
+        factors.push_back(1);
+    }
+
+    for (int direction = 0; direction < 2; direction++)
+    {
+        twiddles[direction].resize(size);
+        for (int k = 0; k < size; k++)
+        {
+            double phase = (direction == 0 ? -2.0 : 2.0) * M_PI * k / size;
+            twiddles[direction][k] = Complex(std::cos(phase), std::sin(phase));
+        }
+    }
+}
+
+// One level of the recursion: split the p * m points at in (every
+// stride * inStride-th value) into p interleaved transforms of length m,
+// written one after the other into out, then combine them with radix-p
+// butterflies (after the ones of KISS FFT). stride is also the twiddle step: size / (p * m).
+void Fft::work(Complex *out, const Complex *in, int stride, int inStride, const int *factor, bool inverse) const
+{
+    int p = factor[0];
+    int m = factor[1];
+    const Complex *tw = twiddles[inverse ? 1 : 0].data();
+
+    if (m == 1)
+    {
+        for (int k = 0; k < p; k++)
+        {
+            out[k] = in[static_cast<long>(k) * stride * inStride];
+        }
+    }
+    else
+    {
+        for (int k = 0; k < p; k++)
+        {
+            work(out + k * m, in + static_cast<long>(k) * stride * inStride, stride * p, inStride, factor + 2,
+                 inverse);
+        }
+    }
+
+    switch (p)
+    {
+    case 1:
+        break;
+    case 2:
+        for (int u = 0; u < m; u++)
+        {
+            Complex t = multiply(out[u + m], tw[u * stride]);
+            out[u + m] = out[u] - t;
+            out[u] += t;
+        }
+        break;
+    case 4:
+        for (int u = 0; u < m; u++)
+        {
+            Complex s0 = multiply(out[u + m], tw[u * stride]);
+            Complex s1 = multiply(out[u + 2 * m], tw[2 * u * stride]);
+            Complex s2 = multiply(out[u + 3 * m], tw[3 * u * stride]);
+            Complex s5 = out[u] - s1;
+            Complex a = out[u] + s1;
+            Complex s3 = s0 + s2;
+            Complex s4 = s0 - s2;
+            // s4 turned by -i (forward) or +i (inverse)
+            Complex turned = inverse ? Complex(-s4.imag(), s4.real()) : Complex(s4.imag(), -s4.real());
+            out[u] = a + s3;
+            out[u + 2 * m] = a - s3;
+            out[u + m] = s5 + turned;
+            out[u + 3 * m] = s5 - turned;
+        }
+        break;
+    case 3:
+    {
+        // epi3 = exp(-+2 pi i / 3); its real part is -1/2.
+        Complex epi3 = tw[stride * m];
+        for (int u = 0; u < m; u++)
+        {
+            Complex s1 = multiply(out[u + m], tw[u * stride]);
+            Complex s2 = multiply(out[u + 2 * m], tw[2 * u * stride]);
+            Complex sum = s1 + s2;
+            Complex difference = (s1 - s2) * epi3.imag();
+            Complex half = out[u] - sum * 0.5;
+            out[u] += sum;
+            out[u + m] = Complex(half.real() - difference.imag(), half.imag() + difference.real());
+            out[u + 2 * m] = Complex(half.real() + difference.imag(), half.imag() - difference.real());
+        }
+        break;
+    }
+    default:
+    {
+        // Radix 5, with ya = exp(-+2 pi i / 5) and yb = ya^2.
+        Complex ya = tw[stride * m];
+        Complex yb = tw[2 * stride * m];
+        for (int u = 0; u < m; u++)
+        {
+            Complex s0 = out[u];
+            Complex s1 = multiply(out[u + m], tw[u * stride]);
+            Complex s2 = multiply(out[u + 2 * m], tw[2 * u * stride]);
+            Complex s3 = multiply(out[u + 3 * m], tw[3 * u * stride]);
+            Complex s4 = multiply(out[u + 4 * m], tw[4 * u * stride]);
+            Complex s7 = s1 + s4, s10 = s1 - s4;
+            Complex s8 = s2 + s3, s9 = s2 - s3;
+
+            out[u] = s0 + s7 + s8;
+            Complex s5(s0.real() + s7.real() * ya.real() + s8.real() * yb.real(),
+                       s0.imag() + s7.imag() * ya.real() + s8.imag() * yb.real());
+            Complex s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+                       -s10.real() * ya.imag() - s9.real() * yb.imag());
+            out[u + m] = s5 - s6;
+            out[u + 4 * m] = s5 + s6;
+
+            Complex s11(s0.real() + s7.real() * yb.real() + s8.real() * ya.real(),
+                        s0.imag() + s7.imag() * yb.real() + s8.imag() * ya.real());
+            Complex s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+                        s10.real() * yb.imag() - s9.real() * ya.imag());
+            out[u + 2 * m] = s11 + s12;
+            out[u + 3 * m] = s11 - s12;
+        }
+        break;
+    }
+    }
+}
+
+void Fft::transform(const Complex *in, int stride, Complex *out, bool inverse) const
+{
+    work(out, in, 1, stride, factors.data(), inverse);
+}
+
+int Fft::fast_size(int n)
+{
+    for (int candidate = n < 1 ? 1 : n;; candidate++)
+    {
+        int rest = candidate;
+        const int radices[] = {2, 3, 5};
+        for (int r = 0; r < 3; r++)
+        {
+            while (rest % radices[r] == 0)
+            {
+                rest /= radices[r];
+            }
+        }
+        if (rest == 1)
+        {
+            return candidate;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <vector>
+
+// Complex discrete Fourier transform of one fixed length, for the FFT path of
+// Filter::convolve. Mixed radix (Cooley-Tukey with radix 4, 2, 3 and 5
+// butterflies), so the length must be of the form 2^a * 3^b * 5^c; use
+// fast_size() to round a length up to one. No external library is needed.
+class Fft {
+private:
+    int size;
+    std::vector<int> factors; // pairs (radix p, remaining length m), outermost first
+    std::vector<std::complex<double>> twiddles[2]; // exp(-+2 pi i k / size), forward and inverse
+
+    void work(std::complex<double>* out, const std::complex<double>* in, int stride, int inStride,
+              const int* factor, bool inverse) const;
+
+public:
+    // Constructor: plan transforms of the given length (2^a * 3^b * 5^c)
+    explicit Fft(int size);
+
+    int get_size() const { return size; }
+
+    // out[k] = sum over j of in[j * stride] * exp(-2 pi i j k / size), or with
+    // +2 pi i when inverse (unscaled: forward then inverse multiplies by size).
+    // out must not overlap in.
+    void transform(const std::complex<double>* in, int stride, std::complex<double>* out, bool inverse) const;
+
+    // a * b without the NaN and infinity handling of operator*, which is a
+    // library call unless the compiler may assume finite values
+    static std::complex<double> multiply(const std::complex<double>& a, const std::complex<double>& b) {
+        return std::complex<double>(a.real() * b.real() - a.imag() * b.imag(),
+                                    a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // Smallest length >= n that Fft accepts
+    static int fast_size(int n);
+};
+
+#endif // FFT_H
@@ -4,17 +4,57 @@
 #include "GrayscaleImage.h"
 #include <vector>
 
+// How filters see pixels beyond the edge of the image.
+enum BorderMode {
+    BORDER_ZERO,      // 000|abcd|000 (the original behaviour)
+    BORDER_REPLICATE, // aaa|abcd|ddd
+    BORDER_REFLECT,   // cba|abcd|dcb
+    BORDER_WRAP       // bcd|abcd|abc
+};
+
+// How apply_gaussian_smoothing does its arithmetic.
+enum GaussianMode {
+    GAUSSIAN_EXACT, // double precision, truncated to 0 .. 255 (the original behaviour)
+    GAUSSIAN_FIXED, // Q14 integer weights and 32-bit sums, rounded half up;
+                    // the same bytes on every compiler, CPU and SIMD level
+    GAUSSIAN_IIR    // recursive approximation (Young & van Vliet), rounded: the same
+                    // cost for any sigma, kernelSize is ignored; sigma < 0.5 runs EXACT
+};
+
+// All filters work in place. They take a GrayscaleView, so a whole GrayscaleImage
+// or any region of interest inside one (image.view(row, col, h, w)) can be passed
+// without copying; a region is filtered as if it were an image of its own.
 class Filter {
 public:
     static std::vector<std::vector<double>> generate_gaussian_kernel(int kernelSize, double sigma);
+    static std::vector<double> generate_gaussian_kernel_1d(int kernelSize, double sigma);
+    // The 1D kernel in Q14 fixed point, adjusted so the weights sum to exactly 2^14
+    static std::vector<int16_t> generate_gaussian_kernel_fixed(int kernelSize, double sigma);
     // Apply the Mean Filter
-    static void apply_mean_filter(GrayscaleImage& image, int kernelSize = 3);
+    static void apply_mean_filter(const GrayscaleView& image, int kernelSize = 3, BorderMode border = BORDER_ZERO);
+
+    // Apply the Median Filter: each pixel becomes the median of its kernelSize x kernelSize
+    // window (kernelSize up to 255), in constant time per pixel whatever the kernel size
+    static void apply_median_filter(const GrayscaleView& image, int kernelSize = 3, BorderMode border = BORDER_ZERO);
 
     // Apply Gaussian Smoothing Filter
-    static void apply_gaussian_smoothing(GrayscaleImage& image, int kernelSize = 3, double sigma = 1.0);
+    static void apply_gaussian_smoothing(const GrayscaleView& image, int kernelSize = 3, double sigma = 1.0,
+                                         BorderMode border = BORDER_ZERO, GaussianMode mode = GAUSSIAN_EXACT);
 
     // Apply Unsharp Masking Filter
-    static void apply_unsharp_mask(GrayscaleImage& image, int kernelSize = 3, double amount = 1.5);
+    static void apply_unsharp_mask(const GrayscaleView& image, int kernelSize = 3, double amount = 1.5,
+                                   BorderMode border = BORDER_ZERO);
+
+    // Convolve with any kernel of odd width and height: pixel (r, c) becomes the sum of
+    // kernel[i][j] * pixel(r + i - rows / 2, c + j - columns / 2), rounded and clipped
+    // to 0 .. 255. Kernels of low rank (Gaussian, box, Sobel, ...) are detected and run
+    // as separable passes; the rest are applied directly.
+    static void convolve(const GrayscaleView& image, const std::vector<std::vector<double>>& kernel,
+                         BorderMode border = BORDER_ZERO);
+
+    // Map a coordinate that may lie outside [0, length) onto the pixel the border
+    // mode reads instead; -1 means "outside, reads as 0" (BORDER_ZERO).
+    static int border_index(int index, int length, BorderMode border);
 
 };
 
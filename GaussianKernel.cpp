@@ -0,0 +1,110 @@
+#define _USE_MATH_DEFINES
+#include "GaussianKernel.h"
+#include "Image.h"
+#include "Simd.h"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <math.h>
+
+// Constructor: compute the 1D, 2D and fixed-point weights
+GaussianKernel::GaussianKernel(int kernelSize, double sigma)
+    : size(kernelSize > 0 ? kernelSize : 0), sigma(sigma), weights1d(nullptr), weights2d(nullptr),
+      weightsFixed(nullptr)
+{
+    const size_t alignment = 64;
+    weights1d = static_cast<double *>(aligned_allocate(sizeof(double) * size, alignment));
+    weights2d = static_cast<double *>(aligned_allocate(sizeof(double) * size * size, alignment));
+    weightsFixed = static_cast<int16_t *>(aligned_allocate(sizeof(int16_t) * size, alignment));
+
+    int center = size / 2;
+
+    // The 2D kernel, normalized to sum to 1.
+    double sum = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            int x = i - center;
+            int y = j - center;
+            weights2d[i * size + j] = (1.0 / (2.0 * M_PI * sigma * sigma)) * exp(-(x * x + y * y) / (2.0 * sigma * sigma));
+            sum += weights2d[i * size + j];
+        }
+    }
+    for (int i = 0; i < size * size; i++)
+    {
+        weights2d[i] /= sum;
+    }
+
+    // The 1D kernel; the 2D kernel is its outer product with itself.
+    sum = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        int x = i - center;
+        weights1d[i] = exp(-(x * x) / (2.0 * sigma * sigma));
+        sum += weights1d[i];
+    }
+    for (int i = 0; i < size; i++)
+    {
+        weights1d[i] /= sum;
+    }
+
+    // Q14 weights: each rounded to the nearest 1/2^14, with the rounding error
+    // folded into the centre tap so they sum to exactly 2^14 and a flat image
+    // stays flat. The centre tap is its own mirror, so symmetry is kept.
+    const int one = 1 << Simd::FIXED_WEIGHT_BITS;
+    int fixedSum = 0;
+    for (int i = 0; i < size; i++)
+    {
+        weightsFixed[i] = static_cast<int16_t>(std::lround(weights1d[i] * one));
+        fixedSum += weightsFixed[i];
+    }
+    if (size > 0)
+    {
+        weightsFixed[center] = static_cast<int16_t>(weightsFixed[center] + one - fixedSum);
+    }
+}
+
+// Destructor
+GaussianKernel::~GaussianKernel()
+{
+    aligned_free(weights1d);
+    aligned_free(weights2d);
+    aligned_free(weightsFixed);
+}
+
+// Batch runs use a handful of (kernelSize, sigma) pairs over and over; a run
+// sweeping sigma finely must not grow the cache without bound, so it is
+// simply emptied once it holds this many kernels.
+static const size_t MAX_CACHED_KERNELS = 256;
+
+static std::mutex cacheMutex;
+static std::map<std::pair<int, double>, std::shared_ptr<const GaussianKernel>> cache;
+
+// Kernel for (kernelSize, sigma), from the cache when possible
+std::shared_ptr<const GaussianKernel> GaussianKernel::get(int kernelSize, double sigma)
+{
+    std::pair<int, double> key(kernelSize, sigma);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto found = cache.find(key);
+    if (found != cache.end())
+    {
+        return found->second;
+    }
+
+    if (cache.size() >= MAX_CACHED_KERNELS)
+    {
+        cache.clear();
+    }
+    std::shared_ptr<const GaussianKernel> kernel(new GaussianKernel(kernelSize, sigma));
+    cache[key] = kernel;
+    return kernel;
+}
+
+// Drop every cached kernel
+void GaussianKernel::clear_cache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.clear();
+}
@@ -0,0 +1,49 @@
+#ifndef GAUSSIAN_KERNEL_H
+#define GAUSSIAN_KERNEL_H
+
+#include <cstdint>
+#include <memory>
+
+// A normalized Gaussian kernel for one (kernelSize, sigma), in every form the
+// filters use: the 1D weights, the full 2D kernel (row-major, kernelSize *
+// kernelSize values in one block) and the 1D weights in Q14 fixed point. They
+// are computed once, into 64-byte aligned storage, and shared through get().
+class GaussianKernel {
+private:
+    int size;
+    double sigma;
+    double* weights1d;
+    double* weights2d;
+    int16_t* weightsFixed;
+
+    // Constructor: compute all three forms
+    GaussianKernel(int kernelSize, double sigma);
+
+public:
+    // Destructor
+    ~GaussianKernel();
+
+    GaussianKernel(const GaussianKernel&) = delete;
+    GaussianKernel& operator=(const GaussianKernel&) = delete;
+
+    int get_size() const { return size; }
+    double get_sigma() const { return sigma; }
+
+    // size weights summing to 1
+    const double* get_weights_1d() const { return weights1d; }
+
+    // size * size weights summing to 1; row i starts at get_weights_2d() + i * size
+    const double* get_weights_2d() const { return weights2d; }
+
+    // The 1D weights in Q14 (see Simd::FIXED_WEIGHT_BITS), summing to exactly 2^14
+    const int16_t* get_weights_fixed() const { return weightsFixed; }
+
+    // Kernel for (kernelSize, sigma), computed on first use and cached; safe to
+    // call from any thread. The kernel stays valid while the caller holds it.
+    static std::shared_ptr<const GaussianKernel> get(int kernelSize, double sigma);
+
+    // Drop every cached kernel. Kernels still held by callers stay valid.
+    static void clear_cache();
+};
+
+#endif // GAUSSIAN_KERNEL_H
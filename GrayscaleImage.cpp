@@ -1,11 +1,14 @@
 #include "GrayscaleImage.h"
+#include "Simd.h"
 #include <iostream>
 #include <cstring> // For memcpy
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 // Constructor: load from a file
 GrayscaleImage::GrayscaleImage(const char *filename)
@@ -13,7 +16,8 @@ GrayscaleImage::GrayscaleImage(const char *filename)
 
     // Image loading code using stbi
     int channels;
-    unsigned char *image = stbi_load(filename, &width, &height, &channels, STBI_grey);
+    int w, h;
+    unsigned char *image = stbi_load(filename, &w, &h, &channels, STBI_grey);
 
     if (image == nullptr)
     {
@@ -21,21 +25,13 @@ GrayscaleImage::GrayscaleImage(const char *filename)
         exit(1);
     }
 
-    // Dynamically allocate memory for a 2D matrix based on the given dimensions.
-    data = new int *[height];
+    // Allocate one contiguous buffer for the whole image.
+    allocate(w, h);
 
+    // stbi already hands out 8-bit grey, so rows are copied as they are
     for (int i = 0; i < height; i++)
     {
-        data[i] = new int[width];
-    }
-
-    // Fill the matrix with pixel values from the image
-    for (int i = 0; i < height; i++)
-    {
-        for (int j = 0; j < width; j++)
-        {
-            data[i][j] = static_cast<int>(image[i * width + j]);
-        }
+        std::memcpy(get_row(i), image + static_cast<long>(i) * width, width);
     }
 
     // Free the dynamically allocated memory of stbi image
@@ -43,176 +39,224 @@ GrayscaleImage::GrayscaleImage(const char *filename)
 }
 
 // Constructor: initialize from a pre-existing data matrix
-GrayscaleImage::GrayscaleImage(int **inputData, int h, int w)
+GrayscaleImage::GrayscaleImage(int **inputData, int h, int w) : Image<uint8_t>(w, h)
 {
     // Initialize the image with a pre-existing data matrix by copying the values.
-    // Don't forget to dynamically allocate memory for the matrix.
-    data = new int *[h];
-    for (int i = 0; i < h; i++)
-    {
-        data[i] = new int[w];
-    }
-
     for (int i = 0; i < h; i++)
     {
+        uint8_t *dst = get_row(i);
         for (int j = 0; j < w; j++)
         {
-            data[i][j] = inputData[i][j];
+            dst[j] = static_cast<uint8_t>(inputData[i][j]);
         }
     }
 }
 
 // Constructor to create a blank image of given width and height
-GrayscaleImage::GrayscaleImage(int w, int h) : width(w), height(h)
+GrayscaleImage::GrayscaleImage(int w, int h) : Image<uint8_t>(w, h)
 {
-    // Just dynamically allocate the memory for the new matrix.
-    data = new int *[height];
-
-    for (int i = 0; i < height; i++)
-    {
-        data[i] = new int[width];
-        for (int j = 0; j < width; j++)
-        {
-            data[i][j] = 255;
-        }
-    }
+    // Paint every pixel white.
+    fill(255);
 }
 
 // Copy constructor
-GrayscaleImage::GrayscaleImage(const GrayscaleImage &other)
+GrayscaleImage::GrayscaleImage(const GrayscaleImage &other) : Image<uint8_t>(other)
 {
-    height = other.get_height();
-    width = other.get_width();
-    // Copy constructor: dynamically allocate memory and
-    // copy pixel values from another image.
-    data = new int *[height];
+}
+
+// Move constructor
+GrayscaleImage::GrayscaleImage(GrayscaleImage &&other) : Image<uint8_t>(std::move(other))
+{
+}
+
+// Constructor: copy the pixels of a plain 8-bit image
+GrayscaleImage::GrayscaleImage(const Image<uint8_t> &other) : Image<uint8_t>(other)
+{
+}
+
+// Constructor: take over the buffer of a plain 8-bit image
+GrayscaleImage::GrayscaleImage(Image<uint8_t> &&other) : Image<uint8_t>(std::move(other))
+{
+}
+
+// Constructor: copy the pixels seen through a view
+GrayscaleImage::GrayscaleImage(const ConstGrayscaleView &view) : Image<uint8_t>(view)
+{
+}
+
+// Copy assignment
+GrayscaleImage &GrayscaleImage::operator=(const GrayscaleImage &other)
+{
+    Image<uint8_t>::operator=(other);
+    return *this;
+}
+
+// Move assignment
+GrayscaleImage &GrayscaleImage::operator=(GrayscaleImage &&other)
+{
+    Image<uint8_t>::operator=(std::move(other));
+    return *this;
+}
+
+// Equality operator
+bool GrayscaleImage::operator==(const GrayscaleImage &other) const
+{
+    if (get_height() != other.get_height() || get_width() != other.get_width())
+    {
+        return false;
+    }
+
+    // Hashes that are already known settle most mismatches without a pass
+    // over the pixels; equal hashes still get the exact comparison.
+    if (hashKnown && other.hashKnown && hash != other.hash)
+    {
+        return false;
+    }
     for (int i = 0; i < height; i++)
     {
-        data[i] = new int[width];
-        for (int j = 0; j < width; j++)
+        if (std::memcmp(get_row(i), other.get_row(i), width) != 0)
         {
-            data[i][j] = other.get_pixel(i, j);
+            return false;
         }
     }
+    return true;
 }
 
-// Destructor
-GrayscaleImage::~GrayscaleImage()
+// Check that two views can be combined pixel by pixel
+static void check_same_size(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
 {
-    // Destructor: deallocate memory for the matrix.
-    for (int i = 0; i < height; i++)
+    if (a.get_width() != b.get_width() || a.get_height() != b.get_height())
     {
-        delete[] data[i];
+        throw std::invalid_argument("ERROR: IMAGE DIMENSIONS DO NOT MATCH.");
     }
-    delete[] data;
-    data = nullptr;
 }
 
-// Equality operator
-bool GrayscaleImage::operator==(const GrayscaleImage &other) const
+// Add two views' pixel values into result, clamping the results.
+void GrayscaleImage::add(const ConstGrayscaleView &a, const ConstGrayscaleView &b, const GrayscaleView &result)
 {
-    // Check if two images have the same dimensions and pixel values.
-    // If they do, return true.
-    if (get_height() == other.get_height() && get_width() == other.get_width())
-    {
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {
-                if (get_pixel(i, j) != other.get_pixel(i, j))
-                {
+    check_same_size(a, b);
+    check_same_size(a, result);
 
-                    return false;
-                }
-            }
-        }
-        return true;
+    for (int i = 0; i < a.get_height(); i++)
+    {
+        Simd::saturating_add_row(a.get_row(i), b.get_row(i), result.get_row(i), a.get_width());
     }
-    return false;
 }
 
-// Addition operator
-GrayscaleImage GrayscaleImage::operator+(const GrayscaleImage &other) const
+// Subtract b's pixel values from a's into result, clamping the results.
+void GrayscaleImage::subtract(const ConstGrayscaleView &a, const ConstGrayscaleView &b, const GrayscaleView &result)
 {
-    // Create a new image for the result
-    GrayscaleImage result(width, height);
+    check_same_size(a, b);
+    check_same_size(a, result);
 
-    // Add two images' pixel values and return a new image, clamping the results.
-    for (int i = 0; i < height; i++)
+    for (int i = 0; i < a.get_height(); i++)
     {
-        for (int j = 0; j < width; j++)
-        {
-            if (get_pixel(i, j) + other.get_pixel(i, j) <= 255)
-            {
-                result.set_pixel(i, j, get_pixel(i, j) + other.get_pixel(i, j));
-            }
-            else
-            {
-                result.set_pixel(i, j, 255);
-            }
-        }
+        Simd::saturating_subtract_row(a.get_row(i), b.get_row(i), result.get_row(i), a.get_width());
     }
-    return result;
 }
 
-// Subtraction operator
-GrayscaleImage GrayscaleImage::operator-(const GrayscaleImage &other) const
+// In-place addition: the sum is written over this image's own pixels
+GrayscaleImage &GrayscaleImage::operator+=(const ConstGrayscaleView &other)
 {
-    // Create a new image for the result
-    GrayscaleImage result(width, height);
+    (view() + other).evaluate_into(view());
+    return *this;
+}
 
-    // Subtract pixel values of two images and return a new image, clamping the results.
-    for (int i = 0; i < height; i++)
+// In-place subtraction
+GrayscaleImage &GrayscaleImage::operator-=(const ConstGrayscaleView &other)
+{
+    (view() - other).evaluate_into(view());
+    return *this;
+}
+
+// Find where two views differ, tile by tile
+std::vector<TileDifference> GrayscaleImage::compare_tiles(const ConstGrayscaleView &a, const ConstGrayscaleView &b,
+                                                          int tileSize)
+{
+    check_same_size(a, b);
+    if (tileSize < 1)
     {
-        for (int j = 0; j < width; j++)
+        throw std::invalid_argument("ERROR: TILE SIZE MUST BE POSITIVE.");
+    }
+
+    int width = a.get_width();
+    int tilesAcross = (width + tileSize - 1) / tileSize;
+    std::vector<TileDifference> differences;
+    std::vector<TileDifference> band(tilesAcross);
+
+    for (int top = 0; top < a.get_height(); top += tileSize)
+    {
+        int bottom = std::min(top + tileSize, a.get_height());
+        for (int t = 0; t < tilesAcross; t++)
         {
-            if (get_pixel(i, j) - other.get_pixel(i, j) > 0)
+            TileDifference &tile = band[t];
+            tile.tileRow = top / tileSize;
+            tile.tileColumn = t;
+            tile.firstRow = bottom;
+            tile.lastRow = top - 1;
+            tile.firstColumn = width;
+            tile.lastColumn = -1;
+            tile.pixels = 0;
+        }
+
+        for (int i = top; i < bottom; i++)
+        {
+            const uint8_t *rowA = a.get_row(i);
+            const uint8_t *rowB = b.get_row(i);
+            for (int t = 0; t < tilesAcross; t++)
             {
-                result.set_pixel(i, j, get_pixel(i, j) - other.get_pixel(i, j));
+                // Equal runs, by far the common case, cost one memcmp.
+                int left = t * tileSize;
+                int right = std::min(left + tileSize, width);
+                if (std::memcmp(rowA + left, rowB + left, right - left) == 0)
+                {
+                    continue;
+                }
+                TileDifference &tile = band[t];
+                for (int j = left; j < right; j++)
+                {
+                    if (rowA[j] != rowB[j])
+                    {
+                        tile.firstRow = std::min(tile.firstRow, i);
+                        tile.lastRow = i;
+                        tile.firstColumn = std::min(tile.firstColumn, j);
+                        tile.lastColumn = std::max(tile.lastColumn, j);
+                        tile.pixels++;
+                    }
+                }
             }
-            else
+        }
+
+        for (int t = 0; t < tilesAcross; t++)
+        {
+            if (band[t].pixels > 0)
             {
-                result.set_pixel(i, j, 0);
+                differences.push_back(band[t]);
             }
         }
     }
-
-    return result;
+    return differences;
 }
 
 // Get a specific pixel value
 int GrayscaleImage::get_pixel(int row, int col) const
 {
-    return data[row][col];
+    return get_row(row)[col];
 }
 
 // Set a specific pixel value
 void GrayscaleImage::set_pixel(int row, int col, int value)
 {
-    data[row][col] = value;
+    get_row(row)[col] = static_cast<uint8_t>(value);
 }
 
 // Function to save the image to a PNG file
 void GrayscaleImage::save_to_file(const char *filename) const
 {
-    // Create a buffer to hold the image data in the format stb_image_write expects
-    unsigned char *imageBuffer = new unsigned char[width * height];
-
-    // Fill the buffer with pixel data (convert int to unsigned char)
-    for (int i = 0; i < height; ++i)
-    {
-        for (int j = 0; j < width; ++j)
-        {
-            imageBuffer[i * width + j] = static_cast<unsigned char>(data[i][j]);
-        }
-    }
-
-    // Write the buffer to a PNG file
-    if (!stbi_write_png(filename, width, height, 1, imageBuffer, width))
+    // The buffer is already 8-bit grey; stb_image_write takes the row stride
+    // directly, so no conversion buffer is needed.
+    if (!stbi_write_png(filename, width, height, 1, pixels, stride))
     {
         std::cerr << "Error: Could not save image to file " << filename << std::endl;
     }
-
-    // Clean up the allocated buffer
-    delete[] imageBuffer;
 }
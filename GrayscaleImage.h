@@ -1,17 +1,30 @@
 #ifndef GRAYSCALE_IMAGE_H
 #define GRAYSCALE_IMAGE_H
 
-class GrayscaleImage {
-private:
-    int** data;
-    int width, height;
+#include "Image.h"
+#include "PixelExpression.h"
+#include <vector>
 
+// Views over 8-bit grey pixels, e.g. a region of interest inside a GrayscaleImage
+typedef ImageView<uint8_t> GrayscaleView;
+typedef ImageView<const uint8_t> ConstGrayscaleView;
 
+// Where two images differ inside one tile of a compare_tiles grid: the bounding
+// box of the differing pixels (inclusive) and how many there are
+struct TileDifference {
+    int tileRow, tileColumn;
+    int firstRow, lastRow;
+    int firstColumn, lastColumn;
+    long pixels;
+};
+
+// 8-bit grey image: Image<uint8_t> plus PNG I/O and pixelwise arithmetic.
+class GrayscaleImage : public Image<uint8_t> {
 public:
     // Constructor: loads an image from a file
     GrayscaleImage(const char* filename);
 
-    // Constructor: initializes from a 2D data matrix
+    // Constructor: initializes from a 2D data matrix (values are narrowed to 8 bits)
     GrayscaleImage(int** inputData, int h, int w);
 
     // Constructor to create a blank image of given width and height
@@ -20,31 +33,80 @@ public:
     // Copy constructor
     GrayscaleImage(const GrayscaleImage& other);
 
-    // Destructor
-    ~GrayscaleImage();
+    // Move constructor: takes over the pixel buffer without copying
+    GrayscaleImage(GrayscaleImage&& other);
+
+    // Constructor: copies a plain 8-bit image, e.g. the result of
+    // convert_to<uint8_t>() on a float intermediate
+    GrayscaleImage(const Image<uint8_t>& other);
+
+    // Constructor: takes over the buffer of a plain 8-bit image
+    GrayscaleImage(Image<uint8_t>&& other);
+
+    // Constructor: copies the pixels seen through a view (e.g. a region of interest)
+    explicit GrayscaleImage(const ConstGrayscaleView& view);
+
+    // Constructor: evaluates a pixel expression such as a + b - c in a single
+    // pass (see PixelExpression.h); only the result image is allocated
+    template <typename Left, typename Right, typename Operation>
+    GrayscaleImage(const PixelExpression<Left, Right, Operation>& expression)
+        : Image<uint8_t>(expression.get_width(), expression.get_height()) {
+        expression.evaluate_into(view());
+    }
+
+    // Copy and move assignment
+    GrayscaleImage& operator=(const GrayscaleImage& other);
+    GrayscaleImage& operator=(GrayscaleImage&& other);
+
+    // Assign a pixel expression, reusing this image's buffer when the size matches
+    template <typename Left, typename Right, typename Operation>
+    GrayscaleImage& operator=(const PixelExpression<Left, Right, Operation>& expression) {
+        if (expression.get_width() == width && expression.get_height() == height) {
+            expression.evaluate_into(view());
+        } else {
+            *this = GrayscaleImage(expression);
+        }
+        return *this;
+    }
 
-    // Operator overloads
+    // Operator overloads. + and - on images and views build a PixelExpression.
+    // == compares rows with memcmp, and fails fast when both content hashes are known.
     bool operator==(const GrayscaleImage& other) const;
-    GrayscaleImage operator+(const GrayscaleImage& other) const;
-    GrayscaleImage operator-(const GrayscaleImage& other) const;
 
-    // Method to get image dimensions
-    int get_width() const { return width; }
-    int get_height() const { return height; }
+    // Clamped sum / difference computed in place, without allocating an image
+    GrayscaleImage& operator+=(const ConstGrayscaleView& other);
+    GrayscaleImage& operator-=(const ConstGrayscaleView& other);
+
+    template <typename Left, typename Right, typename Operation>
+    GrayscaleImage& operator+=(const PixelExpression<Left, Right, Operation>& expression) {
+        (view() + expression).evaluate_into(view());
+        return *this;
+    }
+
+    template <typename Left, typename Right, typename Operation>
+    GrayscaleImage& operator-=(const PixelExpression<Left, Right, Operation>& expression) {
+        (view() - expression).evaluate_into(view());
+        return *this;
+    }
+
+    // Clamped pixelwise sum / difference of two equally sized views, written into
+    // result (which must have the same size). No pixels are copied or allocated.
+    static void add(const ConstGrayscaleView& a, const ConstGrayscaleView& b, const GrayscaleView& result);
+    static void subtract(const ConstGrayscaleView& a, const ConstGrayscaleView& b, const GrayscaleView& result);
+
+    // Split two equally sized views into tileSize x tileSize tiles and list the
+    // tiles that differ, in row-major order; empty when the views are equal
+    static std::vector<TileDifference> compare_tiles(const ConstGrayscaleView& a, const ConstGrayscaleView& b,
+                                                     int tileSize);
 
     // Get a specific pixel value
     int get_pixel(int row, int col) const;
 
-    // Set a specific pixel value
+    // Set a specific pixel value (stored as 8 bits, like save_to_file always did)
     void set_pixel(int row, int col, int value);
 
     // Function to write the image data back to a PNG file
     void save_to_file(const char* filename) const;
-
-    // Getter function for data.
-    int** get_data() const {
-        return data;
-    }
 };
 
 #endif // GRAYSCALE_IMAGE_H
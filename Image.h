@@ -0,0 +1,334 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <new>
+
+#include "ContentHash.h"
+#include "ImageView.h"
+
+// Allocate a block whose start is aligned to the given power-of-two boundary.
+// The pointer returned by malloc is stashed just before the aligned block.
+inline void *aligned_allocate(size_t bytes, size_t alignment)
+{
+    void *raw = std::malloc(bytes + alignment + sizeof(void *));
+    if (raw == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+    uintptr_t aligned = (start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    reinterpret_cast<void **>(aligned)[-1] = raw;
+    return reinterpret_cast<void *>(aligned);
+}
+
+// Free a block obtained from aligned_allocate.
+inline void aligned_free(void *block)
+{
+    if (block != nullptr)
+    {
+        std::free(reinterpret_cast<void **>(block)[-1]);
+    }
+}
+
+// Convert one pixel value to another pixel type. Integer targets are rounded
+// to nearest (when coming from floating point) and clamped to their range;
+// floating point targets take the value as it is.
+template <typename To, typename From>
+inline To saturate_pixel(From value)
+{
+    if (!std::numeric_limits<To>::is_integer)
+    {
+        return static_cast<To>(value);
+    }
+
+    const double lowest = static_cast<double>(std::numeric_limits<To>::min());
+    const double highest = static_cast<double>(std::numeric_limits<To>::max());
+    double v = static_cast<double>(value);
+    if (!std::numeric_limits<From>::is_integer)
+    {
+        v = std::floor(v + 0.5);
+    }
+    return static_cast<To>(v < lowest ? lowest : (v > highest ? highest : v));
+}
+
+// Single-channel image over an arbitrary pixel type (uint8_t, uint16_t, float, ...).
+template <typename T>
+class Image {
+protected:
+    // Pixels live in one contiguous buffer; row r starts at pixels + r * stride.
+    // Rows are padded so that every row start is ROW_ALIGNMENT-byte aligned.
+    T* pixels;
+    int width, height;
+    int stride;
+
+    // Row pointer table handed out by get_data(), built lazily on first use.
+    mutable T** rows;
+
+    // content_hash() of the current pixels, valid while hashKnown. Every
+    // non-const way to reach the pixels clears hashKnown.
+    mutable uint64_t hash;
+    mutable bool hashKnown;
+
+    // Empty image; derived classes call allocate() once they know the size.
+    Image() : pixels(nullptr), width(0), height(0), stride(0), rows(nullptr), hash(0), hashKnown(false) {}
+
+    // Allocate an uninitialized buffer for a w x h image.
+    void allocate(int w, int h);
+
+    // Free the pixel buffer and the row pointer table.
+    void release();
+
+public:
+    typedef T PixelType;
+
+    // Byte alignment of the start of every row.
+    static const int ROW_ALIGNMENT = 64;
+
+    // Constructor: uninitialized image of given width and height
+    Image(int w, int h) : rows(nullptr), hash(0) { allocate(w, h); }
+
+    // Constructor: copies the pixels seen through a view (e.g. a region of interest)
+    explicit Image(const ImageView<const T>& view);
+
+    // Copy constructor
+    Image(const Image& other);
+
+    // Move constructor: takes over the buffer, leaving other empty
+    Image(Image&& other);
+
+    // Copy assignment: reuses the buffer when the dimensions match
+    Image& operator=(const Image& other);
+
+    // Move assignment: releases the current buffer and takes over other's
+    Image& operator=(Image&& other);
+
+    // Destructor
+    ~Image() { release(); }
+
+    // Method to get image dimensions
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+    // Distance between the starts of two consecutive rows, in pixels
+    int get_stride() const { return stride; }
+
+    // Pointer to the first pixel of a row in the contiguous buffer
+    T* get_row(int row) { hashKnown = false; return pixels + static_cast<long>(row) * stride; }
+    const T* get_row(int row) const { return pixels + static_cast<long>(row) * stride; }
+
+    // Get / set a specific pixel value
+    T get_pixel(int row, int col) const { return get_row(row)[col]; }
+    void set_pixel(int row, int col, T value) { get_row(row)[col] = value; }
+
+    // 64-bit hash (XXH64) of the dimensions and pixel values, ignoring row
+    // padding. Computed on first use and cached until the pixels can have
+    // changed; writes through a view taken before the call are not noticed.
+    uint64_t content_hash() const;
+
+    // Set every pixel to the same value
+    void fill(T value);
+
+    // Non-owning views over the whole image or over the h x w rectangle at (row, col)
+    ImageView<T> view() { hashKnown = false; return ImageView<T>(pixels, width, height, stride); }
+    ImageView<const T> view() const { return ImageView<const T>(pixels, width, height, stride); }
+    ImageView<T> view(int row, int col, int h, int w) { return view().sub_view(row, col, h, w); }
+    ImageView<const T> view(int row, int col, int h, int w) const { return view().sub_view(row, col, h, w); }
+
+    // Images can be passed wherever a view is expected
+    operator ImageView<T>() { return view(); }
+    operator ImageView<const T>() const { return view(); }
+
+    // Convert to another pixel type in a single pass (see saturate_pixel).
+    template <typename U>
+    Image<U> convert_to() const;
+
+    // Getter function for data. Compatibility path for code that still indexes
+    // data[row][col]; the returned rows point into the contiguous buffer.
+    T** get_data() const;
+};
+
+typedef Image<uint8_t> ImageU8;
+typedef Image<uint16_t> ImageU16;
+typedef Image<float> ImageF32;
+
+// Allocate an uninitialized buffer for a w x h image with aligned rows
+template <typename T>
+void Image<T>::allocate(int w, int h)
+{
+    width = w;
+    height = h;
+
+    // Round each row up to a whole number of alignment blocks.
+    const int pixelsPerBlock = ROW_ALIGNMENT / sizeof(T);
+    stride = (w + pixelsPerBlock - 1) / pixelsPerBlock * pixelsPerBlock;
+
+    pixels = static_cast<T *>(aligned_allocate(sizeof(T) * static_cast<size_t>(stride) * h, ROW_ALIGNMENT));
+    rows = nullptr;
+    hashKnown = false;
+}
+
+// Free the pixel buffer and the row pointer table
+template <typename T>
+void Image<T>::release()
+{
+    aligned_free(pixels);
+    delete[] rows;
+    pixels = nullptr;
+    rows = nullptr;
+}
+
+// Copy constructor
+template <typename T>
+Image<T>::Image(const Image &other) : rows(nullptr), hash(0)
+{
+    // Both images share the same row layout, so the whole buffer
+    // (row padding included) is copied in one go.
+    allocate(other.width, other.height);
+    std::memcpy(pixels, other.pixels, sizeof(T) * static_cast<size_t>(stride) * height);
+    hash = other.hash;
+    hashKnown = other.hashKnown;
+}
+
+// Constructor: copy the pixels seen through a view
+template <typename T>
+Image<T>::Image(const ImageView<const T> &view) : rows(nullptr), hash(0)
+{
+    allocate(view.get_width(), view.get_height());
+    for (int i = 0; i < height; i++)
+    {
+        std::memcpy(get_row(i), view.get_row(i), sizeof(T) * width);
+    }
+}
+
+// Move constructor
+template <typename T>
+Image<T>::Image(Image &&other)
+    : pixels(other.pixels), width(other.width), height(other.height), stride(other.stride), rows(other.rows),
+      hash(other.hash), hashKnown(other.hashKnown)
+{
+    other.pixels = nullptr;
+    other.rows = nullptr;
+    other.width = 0;
+    other.height = 0;
+    other.stride = 0;
+    other.hashKnown = false;
+}
+
+// Copy assignment
+template <typename T>
+Image<T> &Image<T>::operator=(const Image &other)
+{
+    if (this != &other)
+    {
+        if (width != other.width || height != other.height)
+        {
+            release();
+            allocate(other.width, other.height);
+        }
+        std::memcpy(pixels, other.pixels, sizeof(T) * static_cast<size_t>(stride) * height);
+        hash = other.hash;
+        hashKnown = other.hashKnown;
+    }
+    return *this;
+}
+
+// Move assignment
+template <typename T>
+Image<T> &Image<T>::operator=(Image &&other)
+{
+    if (this != &other)
+    {
+        release();
+        pixels = other.pixels;
+        rows = other.rows;
+        width = other.width;
+        height = other.height;
+        stride = other.stride;
+        hash = other.hash;
+        hashKnown = other.hashKnown;
+
+        other.pixels = nullptr;
+        other.rows = nullptr;
+        other.width = 0;
+        other.height = 0;
+        other.stride = 0;
+        other.hashKnown = false;
+    }
+    return *this;
+}
+
+// Set every pixel to the same value
+template <typename T>
+void Image<T>::fill(T value)
+{
+    for (int i = 0; i < height; i++)
+    {
+        T *dst = get_row(i);
+        for (int j = 0; j < width; j++)
+        {
+            dst[j] = value;
+        }
+    }
+}
+
+// Convert to another pixel type in a single pass
+template <typename T>
+template <typename U>
+Image<U> Image<T>::convert_to() const
+{
+    Image<U> result(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        const T *src = get_row(i);
+        U *dst = result.get_row(i);
+        for (int j = 0; j < width; j++)
+        {
+            dst[j] = saturate_pixel<U>(src[j]);
+        }
+    }
+    return result;
+}
+
+// Hash of the dimensions and pixel values, cached until the pixels may change
+template <typename T>
+uint64_t Image<T>::content_hash() const
+{
+    if (!hashKnown)
+    {
+        ContentHash content;
+        int32_t dimensions[2] = {width, height};
+        content.update(dimensions, sizeof(dimensions));
+        for (int i = 0; i < height; i++)
+        {
+            content.update(get_row(i), sizeof(T) * width);
+        }
+        hash = content.digest();
+        hashKnown = true;
+    }
+    return hash;
+}
+
+// Row pointer table for callers that still index data[row][col]
+template <typename T>
+T **Image<T>::get_data() const
+{
+    // The rows handed out are writable.
+    hashKnown = false;
+    if (rows == nullptr)
+    {
+        rows = new T *[height];
+        for (int i = 0; i < height; i++)
+        {
+            rows[i] = pixels + static_cast<long>(i) * stride;
+        }
+    }
+    return rows;
+}
+
+#endif // IMAGE_H
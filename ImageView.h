@@ -0,0 +1,51 @@
+#ifndef IMAGE_VIEW_H
+#define IMAGE_VIEW_H
+
+#include <stdexcept>
+
+// Non-owning window onto pixels that live somewhere else, usually an Image<T>
+// or a rectangle inside one. Copying a view never copies pixels.
+// T may be const-qualified for read-only views.
+template <typename T>
+class ImageView {
+private:
+    T* data;
+    int width, height;
+    int stride;
+
+public:
+    // Empty view
+    ImageView() : data(nullptr), width(0), height(0), stride(0) {}
+
+    // View over w x h pixels starting at data, rows stride pixels apart
+    ImageView(T* data, int w, int h, int stride) : data(data), width(w), height(h), stride(stride) {}
+
+    // A writable view can always be used where a read-only one is expected
+    operator ImageView<const T>() const { return ImageView<const T>(data, width, height, stride); }
+
+    // Method to get view dimensions
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+    // Distance between the starts of two consecutive rows, in pixels
+    int get_stride() const { return stride; }
+
+    // Pointer to the first pixel of a row of the view
+    T* get_row(int row) const { return data + static_cast<long>(row) * stride; }
+
+    // Get / set a specific pixel value
+    T get_pixel(int row, int col) const { return get_row(row)[col]; }
+    void set_pixel(int row, int col, T value) const { get_row(row)[col] = value; }
+
+    // View of the h x w rectangle whose top-left pixel is (row, col)
+    ImageView sub_view(int row, int col, int h, int w) const
+    {
+        if (row < 0 || col < 0 || h < 0 || w < 0 || row + h > height || col + w > width)
+        {
+            throw std::out_of_range("ERROR: REGION OUTSIDE OF IMAGE.");
+        }
+        return ImageView(get_row(row) + col, w, h, stride);
+    }
+};
+
+#endif // IMAGE_VIEW_H
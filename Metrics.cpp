@@ -0,0 +1,285 @@
+#include "Metrics.h"
+#include "GaussianKernel.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Standard deviation of the Gaussian SSIM window
+static const double SSIM_SIGMA = 1.5;
+
+// SSIM stabilising constants (0.01 * 255)^2 and (0.03 * 255)^2
+static const double SSIM_C1 = 6.5025;
+static const double SSIM_C2 = 58.5225;
+
+// Output rows per SSIM task. Every task re-reads window - 1 rows below its
+// band, so bands are a few windows tall; the box window's integral tables
+// grow with the band as well.
+static const int SSIM_BAND_ROWS = 32;
+
+// Row bands per thread for the error sums
+static const int BANDS_PER_THREAD = 4;
+
+// Exact sums of |a - b| and (a - b)^2 over the whole image
+struct ErrorSums
+{
+    uint64_t absolute;
+    uint64_t squared;
+};
+
+static void check_comparable(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
+{
+    if (a.get_width() != b.get_width() || a.get_height() != b.get_height())
+    {
+        throw std::invalid_argument("ERROR: IMAGE DIMENSIONS DO NOT MATCH.");
+    }
+    if (a.get_width() == 0 || a.get_height() == 0)
+    {
+        throw std::invalid_argument("ERROR: CANNOT COMPARE EMPTY IMAGES.");
+    }
+}
+
+static ErrorSums error_sums(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
+{
+    check_comparable(a, b);
+
+    // Integer sums per band, added up in band order: the same totals for any
+    // number of threads.
+    int height = a.get_height();
+    int bands = std::min(height, BANDS_PER_THREAD * ThreadPool::shared().get_thread_count());
+    std::vector<ErrorSums> partial(bands);
+    ThreadPool::shared().parallel_for(bands, [&](int band) {
+        int first = static_cast<int>(static_cast<long>(height) * band / bands);
+        int last = static_cast<int>(static_cast<long>(height) * (band + 1) / bands);
+        ErrorSums sums = {0, 0};
+        for (int i = first; i < last; i++)
+        {
+            Simd::error_sums_row(a.get_row(i), b.get_row(i), a.get_width(), &sums.absolute, &sums.squared);
+        }
+        partial[band] = sums;
+    });
+
+    ErrorSums total = {0, 0};
+    for (int band = 0; band < bands; band++)
+    {
+        total.absolute += partial[band].absolute;
+        total.squared += partial[band].squared;
+    }
+    return total;
+}
+
+static double psnr_from_mse(double mse)
+{
+    return mse == 0.0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// SSIM of one window from its means, variances and covariance
+static inline double ssim_value(double meanA, double meanB, double varianceA, double varianceB, double covariance)
+{
+    return ((2.0 * meanA * meanB + SSIM_C1) * (2.0 * covariance + SSIM_C2)) /
+           ((meanA * meanA + meanB * meanB + SSIM_C1) * (varianceA + varianceB + SSIM_C2));
+}
+
+// The local statistics are weighted sums of a, b, a^2, b^2 and a * b.
+static const int SSIM_CHANNELS = 5;
+
+// Sum of the SSIM values of output rows [first, last) with a Gaussian window.
+// Each input row is filtered horizontally once, into a ring of windowSize
+// rows per channel; each output row then combines the ring vertically.
+static void gaussian_ssim_rows(const ConstGrayscaleView &a, const ConstGrayscaleView &b, int windowSize, int first,
+                               int last, double *rowSums)
+{
+    std::shared_ptr<const GaussianKernel> kernel = GaussianKernel::get(windowSize, SSIM_SIGMA);
+    const double *weights = kernel->get_weights_1d();
+    int width = a.get_width();
+    int outputWidth = width - windowSize + 1;
+
+    std::vector<double> values(static_cast<size_t>(SSIM_CHANNELS) * width);
+    std::vector<double> ring(static_cast<size_t>(windowSize) * SSIM_CHANNELS * outputWidth);
+    std::vector<double> local(static_cast<size_t>(SSIM_CHANNELS) * outputWidth);
+    std::vector<const double *> tapRows(windowSize);
+    auto slot = [&](int row, int channel) {
+        return &ring[(static_cast<size_t>(row % windowSize) * SSIM_CHANNELS + channel) * outputWidth];
+    };
+
+    for (int r = first; r < last + windowSize - 1; r++)
+    {
+        double *valueA = &values[0];
+        double *valueB = &values[width];
+        Simd::widen_row(a.get_row(r), valueA, width);
+        Simd::widen_row(b.get_row(r), valueB, width);
+        for (int j = 0; j < width; j++)
+        {
+            values[2 * width + j] = valueA[j] * valueA[j];
+            values[3 * width + j] = valueB[j] * valueB[j];
+            values[4 * width + j] = valueA[j] * valueB[j];
+        }
+        for (int channel = 0; channel < SSIM_CHANNELS; channel++)
+        {
+            Simd::convolve_row(&values[static_cast<size_t>(channel) * width], weights, windowSize, slot(r, channel),
+                               outputWidth);
+        }
+        if (r < first + windowSize - 1)
+        {
+            continue;
+        }
+
+        // Output row y covers input rows y .. y + windowSize - 1.
+        int y = r - windowSize + 1;
+        for (int channel = 0; channel < SSIM_CHANNELS; channel++)
+        {
+            for (int t = 0; t < windowSize; t++)
+            {
+                tapRows[t] = slot(y + t, channel);
+            }
+            Simd::weighted_sum_rows(tapRows.data(), weights, windowSize, &local[static_cast<size_t>(channel) * outputWidth],
+                                    outputWidth);
+        }
+
+        const double *meanA = &local[0];
+        const double *meanB = &local[outputWidth];
+        const double *squareA = &local[2 * outputWidth];
+        const double *squareB = &local[3 * outputWidth];
+        const double *product = &local[4 * outputWidth];
+        double rowSum = 0.0;
+        for (int j = 0; j < outputWidth; j++)
+        {
+            rowSum += ssim_value(meanA[j], meanB[j], squareA[j] - meanA[j] * meanA[j],
+                                 squareB[j] - meanB[j] * meanB[j], product[j] - meanA[j] * meanB[j]);
+        }
+        rowSums[y - first] = rowSum;
+    }
+}
+
+// Sum of the SSIM values of output rows [first, last) with a box window. The
+// band's integral images (one per channel, interleaved per pixel, with a row
+// and a column of zeros in front) give every window sum from four lookups,
+// exactly, in 64-bit integers.
+static void box_ssim_rows(const ConstGrayscaleView &a, const ConstGrayscaleView &b, int windowSize, int first,
+                          int last, double *rowSums)
+{
+    int width = a.get_width();
+    int outputWidth = width - windowSize + 1;
+    int rows = last - first + windowSize - 1;
+    size_t tableStride = (static_cast<size_t>(width) + 1) * SSIM_CHANNELS;
+    std::vector<int64_t> table((static_cast<size_t>(rows) + 1) * tableStride, 0);
+
+    for (int r = 0; r < rows; r++)
+    {
+        const uint8_t *rowA = a.get_row(first + r);
+        const uint8_t *rowB = b.get_row(first + r);
+        const int64_t *above = &table[r * tableStride + SSIM_CHANNELS];
+        int64_t *current = &table[(r + 1) * tableStride + SSIM_CHANNELS];
+        int64_t running[SSIM_CHANNELS] = {0, 0, 0, 0, 0};
+        for (int j = 0; j < width; j++)
+        {
+            int64_t x = rowA[j];
+            int64_t y = rowB[j];
+            running[0] += x;
+            running[1] += y;
+            running[2] += x * x;
+            running[3] += y * y;
+            running[4] += x * y;
+            for (int channel = 0; channel < SSIM_CHANNELS; channel++)
+            {
+                current[j * SSIM_CHANNELS + channel] = above[j * SSIM_CHANNELS + channel] + running[channel];
+            }
+        }
+    }
+
+    // With n pixels in the window: n^2 * variance = n * sum(x^2) - sum(x)^2, exactly.
+    const int64_t n = static_cast<int64_t>(windowSize) * windowSize;
+    const double scale = 1.0 / static_cast<double>(n * n);
+    const size_t across = static_cast<size_t>(windowSize) * SSIM_CHANNELS;
+    for (int y = 0; y < last - first; y++)
+    {
+        const int64_t *top = &table[y * tableStride];
+        const int64_t *bottom = &table[(y + windowSize) * tableStride];
+        double rowSum = 0.0;
+        for (int j = 0; j < outputWidth; j++)
+        {
+            size_t left = static_cast<size_t>(j) * SSIM_CHANNELS;
+            int64_t sums[SSIM_CHANNELS];
+            for (int channel = 0; channel < SSIM_CHANNELS; channel++)
+            {
+                sums[channel] = bottom[left + across + channel] - bottom[left + channel] -
+                                top[left + across + channel] + top[left + channel];
+            }
+            double meanA = static_cast<double>(sums[0]) / n;
+            double meanB = static_cast<double>(sums[1]) / n;
+            double varianceA = static_cast<double>(n * sums[2] - sums[0] * sums[0]) * scale;
+            double varianceB = static_cast<double>(n * sums[3] - sums[1] * sums[1]) * scale;
+            double covariance = static_cast<double>(n * sums[4] - sums[0] * sums[1]) * scale;
+            rowSum += ssim_value(meanA, meanB, varianceA, varianceB, covariance);
+        }
+        rowSums[y] = rowSum;
+    }
+}
+
+double Metrics::mean_absolute_error(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
+{
+    ErrorSums sums = error_sums(a, b);
+    return static_cast<double>(sums.absolute) / (static_cast<double>(a.get_width()) * a.get_height());
+}
+
+double Metrics::mean_squared_error(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
+{
+    ErrorSums sums = error_sums(a, b);
+    return static_cast<double>(sums.squared) / (static_cast<double>(a.get_width()) * a.get_height());
+}
+
+double Metrics::psnr(const ConstGrayscaleView &a, const ConstGrayscaleView &b)
+{
+    return psnr_from_mse(mean_squared_error(a, b));
+}
+
+double Metrics::ssim(const ConstGrayscaleView &a, const ConstGrayscaleView &b, SsimWindow window)
+{
+    check_comparable(a, b);
+
+    // Largest odd window up to SSIM_WINDOW_SIZE that fits the image
+    int windowSize = std::min(std::min(a.get_width(), a.get_height()), static_cast<int>(SSIM_WINDOW_SIZE));
+    windowSize -= 1 - windowSize % 2;
+    int outputHeight = a.get_height() - windowSize + 1;
+    int outputWidth = a.get_width() - windowSize + 1;
+
+    // One sum per output row, added up in row order afterwards so that the
+    // result does not depend on how the bands were scheduled.
+    std::vector<double> rowSums(outputHeight);
+    int bands = (outputHeight + SSIM_BAND_ROWS - 1) / SSIM_BAND_ROWS;
+    ThreadPool::shared().parallel_for(bands, [&](int band) {
+        int first = band * SSIM_BAND_ROWS;
+        int last = std::min(first + SSIM_BAND_ROWS, outputHeight);
+        if (window == SSIM_BOX)
+        {
+            box_ssim_rows(a, b, windowSize, first, last, &rowSums[first]);
+        }
+        else
+        {
+            gaussian_ssim_rows(a, b, windowSize, first, last, &rowSums[first]);
+        }
+    });
+
+    double total = 0.0;
+    for (int y = 0; y < outputHeight; y++)
+    {
+        total += rowSums[y];
+    }
+    return total / (static_cast<double>(outputWidth) * outputHeight);
+}
+
+ImageComparison Metrics::compare(const ConstGrayscaleView &a, const ConstGrayscaleView &b, SsimWindow window)
+{
+    ErrorSums sums = error_sums(a, b);
+    double pixels = static_cast<double>(a.get_width()) * a.get_height();
+
+    ImageComparison comparison;
+    comparison.meanAbsoluteError = static_cast<double>(sums.absolute) / pixels;
+    comparison.meanSquaredError = static_cast<double>(sums.squared) / pixels;
+    comparison.psnr = psnr_from_mse(comparison.meanSquaredError);
+    comparison.ssim = ssim(a, b, window);
+    return comparison;
+}
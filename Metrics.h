@@ -0,0 +1,44 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "GrayscaleImage.h"
+
+// Window over which SSIM gathers its local statistics.
+enum SsimWindow {
+    SSIM_GAUSSIAN, // Gaussian, sigma 1.5 (Wang et al. 2004), run as separable passes
+    SSIM_BOX       // uniform, summed exactly from integral images
+};
+
+// Everything Metrics::compare measures between two images
+struct ImageComparison {
+    double meanAbsoluteError;
+    double meanSquaredError;
+    double psnr; // in dB; infinity for identical images
+    double ssim; // 1 for identical images
+};
+
+// Full-reference quality metrics between two equally sized 8-bit images, e.g. a
+// filter output against a golden image. Rows are spread over the shared thread
+// pool and the inner loops run on the Simd kernels; the results do not depend
+// on the thread count or the instruction set.
+class Metrics {
+public:
+    // Side of the SSIM window; smaller images use the largest odd size that fits
+    static const int SSIM_WINDOW_SIZE = 11;
+
+    // Mean of |a - b| and of (a - b)^2 over all pixels
+    static double mean_absolute_error(const ConstGrayscaleView& a, const ConstGrayscaleView& b);
+    static double mean_squared_error(const ConstGrayscaleView& a, const ConstGrayscaleView& b);
+
+    // Peak signal-to-noise ratio for 8-bit pixels: 10 log10(255^2 / MSE)
+    static double psnr(const ConstGrayscaleView& a, const ConstGrayscaleView& b);
+
+    // Mean structural similarity over every window position inside the image
+    static double ssim(const ConstGrayscaleView& a, const ConstGrayscaleView& b, SsimWindow window = SSIM_GAUSSIAN);
+
+    // All of the above, with a single pass for the error sums
+    static ImageComparison compare(const ConstGrayscaleView& a, const ConstGrayscaleView& b,
+                                   SsimWindow window = SSIM_GAUSSIAN);
+};
+
+#endif // METRICS_H
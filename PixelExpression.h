@@ -0,0 +1,192 @@
+#ifndef PIXEL_EXPRESSION_H
+#define PIXEL_EXPRESSION_H
+
+#include "ImageView.h"
+#include "Simd.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Lazy pixelwise arithmetic on 8-bit images and views. a + b - c computes
+// nothing by itself: it builds a small expression tree, and assigning the tree
+// to a GrayscaleImage (or calling evaluate_into on a view) runs all of its
+// operations row by row in one pass, with no temporary images. Every operation
+// still clamps on its own, so the result is the same as applying the
+// operators one at a time.
+//
+// An expression only holds views of its operands; evaluate it within the
+// statement that builds it rather than keeping it in an auto variable.
+
+// Clamped pixelwise sum of two rows; dst may alias either input
+struct SaturatingAdd {
+    static void apply(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n) {
+        Simd::saturating_add_row(a, b, dst, n);
+    }
+};
+
+// Clamped pixelwise difference of two rows; dst may alias either input
+struct SaturatingSubtract {
+    static void apply(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n) {
+        Simd::saturating_subtract_row(a, b, dst, n);
+    }
+};
+
+// Leaf of an expression: the pixels of an image or view
+class PixelOperand {
+private:
+    ImageView<const uint8_t> view;
+
+public:
+    // Scratch rows needed to evaluate this operand, and whether its rows are
+    // computed (false: they are read straight from the view)
+    static const int SCRATCH_ROWS = 0;
+    static const bool COMPUTED = false;
+
+    // Constructor: operand reading the pixels of view
+    PixelOperand(const ImageView<const uint8_t>& view) : view(view) {}
+
+    int get_width() const { return view.get_width(); }
+    int get_height() const { return view.get_height(); }
+
+    // Row i of the operand, read in place; dst and scratch are not used
+    const uint8_t* row(int i, uint8_t*, uint8_t*) const { return view.get_row(i); }
+
+    // Whether the operand shares any pixel memory with result
+    bool overlaps(const ImageView<uint8_t>& result) const {
+        if (get_width() == 0 || get_height() == 0 || result.get_width() == 0 || result.get_height() == 0) {
+            return false;
+        }
+        const uint8_t* begin = view.get_row(0);
+        const uint8_t* end = view.get_row(get_height() - 1) + get_width();
+        const uint8_t* resultBegin = result.get_row(0);
+        const uint8_t* resultEnd = result.get_row(result.get_height() - 1) + result.get_width();
+        return begin < resultEnd && resultBegin < end;
+    }
+
+    // Whether writing result row by row could change pixels before they are
+    // read. The operand may be result itself: each pixel is read just before
+    // it is overwritten.
+    bool needs_copy(const ImageView<uint8_t>& result) const {
+        bool same = view.get_row(0) == result.get_row(0) && view.get_stride() == result.get_stride();
+        return !same && overlaps(result);
+    }
+};
+
+// Operation applied to the values of two subexpressions
+template <typename Left, typename Right, typename Operation>
+class PixelExpression {
+private:
+    Left left;
+    Right right;
+
+public:
+    // The left operand is computed straight into the destination row; a computed
+    // right operand needs a scratch row of its own, plus whatever it needs in turn.
+    static const int RIGHT_ROWS = Right::COMPUTED ? 1 + Right::SCRATCH_ROWS : 0;
+    static const int SCRATCH_ROWS = Left::SCRATCH_ROWS > RIGHT_ROWS ? Left::SCRATCH_ROWS : RIGHT_ROWS;
+    static const bool COMPUTED = true;
+
+    // Constructor: combines two operands of the same size
+    PixelExpression(const Left& left, const Right& right) : left(left), right(right) {
+        if (left.get_width() != right.get_width() || left.get_height() != right.get_height()) {
+            throw std::invalid_argument("ERROR: IMAGE DIMENSIONS DO NOT MATCH.");
+        }
+    }
+
+    int get_width() const { return left.get_width(); }
+    int get_height() const { return left.get_height(); }
+
+    // Row i of the value, computed into dst using SCRATCH_ROWS rows at scratch
+    const uint8_t* row(int i, uint8_t* dst, uint8_t* scratch) const {
+        const uint8_t* a = left.row(i, dst, scratch);
+        const uint8_t* b = right.row(i, scratch, scratch + get_width());
+        Operation::apply(a, b, dst, get_width());
+        return dst;
+    }
+
+    bool overlaps(const ImageView<uint8_t>& result) const {
+        return left.overlaps(result) || right.overlaps(result);
+    }
+
+    // Only the leftmost operand is read before its row of result is written;
+    // everything else must stay clear of result.
+    bool needs_copy(const ImageView<uint8_t>& result) const {
+        return left.needs_copy(result) || right.overlaps(result);
+    }
+
+    // Write the value into result, which must have the same size, in one pass.
+    // result may be one of the operands; when it could be overwritten before
+    // being read (e.g. a shifted view of an operand), the value is built in a
+    // buffer of its own first and copied.
+    void evaluate_into(const ImageView<uint8_t>& result) const {
+        if (result.get_width() != get_width() || result.get_height() != get_height()) {
+            throw std::invalid_argument("ERROR: IMAGE DIMENSIONS DO NOT MATCH.");
+        }
+        int width = get_width();
+        int height = get_height();
+        std::vector<uint8_t> scratch(static_cast<size_t>(SCRATCH_ROWS + 1) * width);
+        if (!needs_copy(result)) {
+            for (int i = 0; i < height; i++) {
+                row(i, result.get_row(i), scratch.data());
+            }
+            return;
+        }
+        std::vector<uint8_t> value(static_cast<size_t>(height) * width);
+        for (int i = 0; i < height; i++) {
+            row(i, value.data() + static_cast<size_t>(i) * width, scratch.data());
+        }
+        for (int i = 0; i < height; i++) {
+            std::memcpy(result.get_row(i), value.data() + static_cast<size_t>(i) * width, width);
+        }
+    }
+};
+
+// Operators building expressions from views (and so from images) and from other expressions
+inline PixelExpression<PixelOperand, PixelOperand, SaturatingAdd>
+operator+(const ImageView<const uint8_t>& a, const ImageView<const uint8_t>& b) {
+    return PixelExpression<PixelOperand, PixelOperand, SaturatingAdd>(a, b);
+}
+
+template <typename L, typename R, typename O>
+PixelExpression<PixelExpression<L, R, O>, PixelOperand, SaturatingAdd>
+operator+(const PixelExpression<L, R, O>& a, const ImageView<const uint8_t>& b) {
+    return PixelExpression<PixelExpression<L, R, O>, PixelOperand, SaturatingAdd>(a, b);
+}
+
+template <typename L, typename R, typename O>
+PixelExpression<PixelOperand, PixelExpression<L, R, O>, SaturatingAdd>
+operator+(const ImageView<const uint8_t>& a, const PixelExpression<L, R, O>& b) {
+    return PixelExpression<PixelOperand, PixelExpression<L, R, O>, SaturatingAdd>(a, b);
+}
+
+template <typename L1, typename R1, typename O1, typename L2, typename R2, typename O2>
+PixelExpression<PixelExpression<L1, R1, O1>, PixelExpression<L2, R2, O2>, SaturatingAdd>
+operator+(const PixelExpression<L1, R1, O1>& a, const PixelExpression<L2, R2, O2>& b) {
+    return PixelExpression<PixelExpression<L1, R1, O1>, PixelExpression<L2, R2, O2>, SaturatingAdd>(a, b);
+}
+
+inline PixelExpression<PixelOperand, PixelOperand, SaturatingSubtract>
+operator-(const ImageView<const uint8_t>& a, const ImageView<const uint8_t>& b) {
+    return PixelExpression<PixelOperand, PixelOperand, SaturatingSubtract>(a, b);
+}
+
+template <typename L, typename R, typename O>
+PixelExpression<PixelExpression<L, R, O>, PixelOperand, SaturatingSubtract>
+operator-(const PixelExpression<L, R, O>& a, const ImageView<const uint8_t>& b) {
+    return PixelExpression<PixelExpression<L, R, O>, PixelOperand, SaturatingSubtract>(a, b);
+}
+
+template <typename L, typename R, typename O>
+PixelExpression<PixelOperand, PixelExpression<L, R, O>, SaturatingSubtract>
+operator-(const ImageView<const uint8_t>& a, const PixelExpression<L, R, O>& b) {
+    return PixelExpression<PixelOperand, PixelExpression<L, R, O>, SaturatingSubtract>(a, b);
+}
+
+template <typename L1, typename R1, typename O1, typename L2, typename R2, typename O2>
+PixelExpression<PixelExpression<L1, R1, O1>, PixelExpression<L2, R2, O2>, SaturatingSubtract>
+operator-(const PixelExpression<L1, R1, O1>& a, const PixelExpression<L2, R2, O2>& b) {
+    return PixelExpression<PixelExpression<L1, R1, O1>, PixelExpression<L2, R2, O2>, SaturatingSubtract>(a, b);
+}
+
+#endif // PIXEL_EXPRESSION_H
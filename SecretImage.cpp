@@ -1,4 +1,5 @@
 #include "SecretImage.h"
+#include <utility>
 
 // Constructor: split image into upper and lower triangular arrays
 SecretImage::SecretImage(const GrayscaleImage &image)
@@ -11,8 +12,8 @@ SecretImage::SecretImage(const GrayscaleImage &image)
     lower_triangular = nullptr;
 
     // 1. Dynamically allocate the memory for the upper and lower triangular matrices.
-    upper_triangular = new int[(height + 1) * height / 2];
-    lower_triangular = new int[(height - 1) * height / 2];
+    upper_triangular = new int[upper_size()];
+    lower_triangular = new int[lower_size()];
 
     // 2. Fill both matrices with the pixels from the GrayscaleImage.
     int i1 = 0;
@@ -45,6 +46,64 @@ SecretImage::SecretImage(int w, int h, int *upper, int *lower)
     lower_triangular = lower;
 }
 
+// Copy constructor: deep-copy both triangular arrays
+SecretImage::SecretImage(const SecretImage &other)
+{
+    width = other.width;
+    height = other.height;
+
+    upper_triangular = new int[upper_size()];
+    lower_triangular = new int[lower_size()];
+    std::copy(other.upper_triangular, other.upper_triangular + upper_size(), upper_triangular);
+    std::copy(other.lower_triangular, other.lower_triangular + lower_size(), lower_triangular);
+}
+
+// Move constructor: take over both arrays
+SecretImage::SecretImage(SecretImage &&other)
+{
+    width = other.width;
+    height = other.height;
+    upper_triangular = other.upper_triangular;
+    lower_triangular = other.lower_triangular;
+
+    other.width = 0;
+    other.height = 0;
+    other.upper_triangular = nullptr;
+    other.lower_triangular = nullptr;
+}
+
+// Copy assignment
+SecretImage &SecretImage::operator=(const SecretImage &other)
+{
+    if (this != &other)
+    {
+        SecretImage copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+// Move assignment
+SecretImage &SecretImage::operator=(SecretImage &&other)
+{
+    if (this != &other)
+    {
+        delete[] upper_triangular;
+        delete[] lower_triangular;
+
+        width = other.width;
+        height = other.height;
+        upper_triangular = other.upper_triangular;
+        lower_triangular = other.lower_triangular;
+
+        other.width = 0;
+        other.height = 0;
+        other.upper_triangular = nullptr;
+        other.lower_triangular = nullptr;
+    }
+    return *this;
+}
+
 // Destructor: free the arrays
 SecretImage::~SecretImage()
 {
@@ -98,8 +157,8 @@ void SecretImage::save_back(const GrayscaleImage &image)
     upper_triangular = nullptr;
     lower_triangular = nullptr;
 
-    upper_triangular = new int[((width + 1) * width) / 2];
-    lower_triangular = new int[((width - 1) * width) / 2];
+    upper_triangular = new int[upper_size()];
+    lower_triangular = new int[lower_size()];
 
     int upperIndex = 0;
     int lowerIndex = 0;
@@ -131,7 +190,7 @@ void SecretImage::save_to_file(const std::string &filename)
     // 2. Write the upper_triangular array to the second line.
     // Ensure that the elements are space-separated.
     // If there are 15 elements, write them as: "element1 element2 ... element15"
-    int upperSize = (width * (width + 1)) / 2;
+    int upperSize = upper_size();
     for (int i = 0; i < upperSize; i++)
     {
         file << upper_triangular[i];
@@ -145,7 +204,7 @@ void SecretImage::save_to_file(const std::string &filename)
 
     // 3. Write the lower_triangular array to the third line in a similar manner
     // as the second line.
-    int lowerSize = (width * (width - 1)) / 2;
+    int lowerSize = lower_size();
     for (int i = 0; i < lowerSize; i++)
     {
         file << lower_triangular[i];
@@ -171,33 +230,50 @@ SecretImage SecretImage::load_from_file(const std::string &filename)
 
     file >> width >> height;
 
-    // 2. Calculate the sizes of the upper and lower triangular arrays.
-    int upperSize = (width * (width + 1)) / 2;
-    int lowerSize = (width * (width - 1)) / 2;
+    // 2. Calculate the sizes of the upper and lower triangular arrays; they depend
+    //    on the height as well as the width when the image is not square.
+    SecretImage secret_image(width, height, nullptr, nullptr);
+    int upperSize = secret_image.upper_size();
+    int lowerSize = secret_image.lower_size();
     // 3. Allocate memory for both arrays.
 
-    int * upper_array = new int[upperSize];
-    int * lower_array = new int[lowerSize];
+    secret_image.upper_triangular = new int[upperSize];
+    secret_image.lower_triangular = new int[lowerSize];
     // 4. Read the upper_triangular array from the second line, space-separated.
     for (int i = 0; i < upperSize; i++)
     {
-        file >> upper_array[i];
+        file >> secret_image.upper_triangular[i];
     }
 
     // 5. Read the lower_triangular array from the third line, space-separated.
     for (int i = 0; i < lowerSize; i++)
     {
-        file >> lower_array[i];
+        file >> secret_image.lower_triangular[i];
     }
 
-    // 6. Close the file and return a SecretImage object initialized with the
-    //    width, height, and triangular arrays.
+    // 6. Close the file and return the SecretImage holding the width, height and
+    //    triangular arrays.
     file.close();
-    SecretImage secret_image(width, height, upper_array, lower_array);
 
     return secret_image;
 }
 
+// Number of pixels on or above the diagonal: row i holds max(0, width - i) of them.
+int SecretImage::upper_size() const
+{
+    if (height <= width)
+    {
+        return height * width - (height * (height - 1)) / 2;
+    }
+    return (width * (width + 1)) / 2;
+}
+
+// Number of pixels below the diagonal: everything the upper array does not hold.
+int SecretImage::lower_size() const
+{
+    return width * height - upper_size();
+}
+
 // Returns a pointer to the upper triangular part of the secret image.
 int *SecretImage::get_upper_triangular() const
 {
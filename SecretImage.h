@@ -18,6 +18,10 @@ private:
     int *lower_triangular; // Array for lower triangular part (excluding diagonal)
     int width, height;
 
+    // Number of pixels stored in each triangular array for a width x height image
+    int upper_size() const;
+    int lower_size() const;
+
 public:
 
     // Constructor: takes a GrayscaleImage and splits it into two triangular arrays
@@ -26,6 +30,16 @@ public:
     // Constructor: instantiate based on data read from file
     SecretImage(int w, int h, int *upper, int *lower);
 
+    // Copy constructor: deep-copies both triangular arrays
+    SecretImage(const SecretImage &other);
+
+    // Move constructor: takes over both arrays, leaving other empty
+    SecretImage(SecretImage &&other);
+
+    // Copy and move assignment
+    SecretImage &operator=(const SecretImage &other);
+    SecretImage &operator=(SecretImage &&other);
+
     // Destructor
     ~SecretImage();
 
@@ -0,0 +1,1311 @@
+#include "Simd.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CLEARVISION_X86_64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CLEARVISION_TARGET_AVX2
+#else
+#define CLEARVISION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Fully unroll the loop that follows when its trip count is a compile-time constant.
+#if defined(__GNUC__)
+#define CLEARVISION_UNROLL _Pragma("GCC unroll 16")
+#else
+#define CLEARVISION_UNROLL
+#endif
+
+// The kernels that loop over filter taps are templates on the tap count, with
+// TAPS = 0 meaning "given at runtime". The common kernel sizes 3 to 11 get an
+// instantiation of their own, in which the tap loop unrolls completely and the
+// weights stay in registers; other sizes take the generic one.
+#define CLEARVISION_DISPATCH_TAPS(kernel, taps, args) \
+    switch (taps)                                   \
+    {                                               \
+    case 3: kernel<3> args; break;                  \
+    case 5: kernel<5> args; break;                  \
+    case 7: kernel<7> args; break;                  \
+    case 9: kernel<9> args; break;                  \
+    case 11: kernel<11> args; break;                \
+    default: kernel<0> args; break;                 \
+    }
+
+// Shifts of the fixed-point passes: Q0 * Q14 -> Q7 along rows, Q7 * Q14 -> Q0 down columns.
+static const int FIXED_ROW_SHIFT = Simd::FIXED_WEIGHT_BITS - 7;
+static const int FIXED_ROW_ROUND = 1 << (FIXED_ROW_SHIFT - 1);
+static const int FIXED_COLUMN_SHIFT = Simd::FIXED_WEIGHT_BITS + 7;
+static const int FIXED_COLUMN_ROUND = 1 << (FIXED_COLUMN_SHIFT - 1);
+
+// ---------------------------------------------------------------------------
+// Portable scalar kernels. These define the results; the vector versions
+// below reproduce them exactly and fall back to them for the row tails.
+// ---------------------------------------------------------------------------
+
+static void widen_row_scalar(const uint8_t *src, double *dst, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        dst[j] = src[j];
+    }
+}
+
+template <int TAPS>
+static void convolve_row_scalar_taps(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = 0; j < n; j++)
+    {
+        double sum = 0.0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += src[j + t] * weights[t];
+        }
+        dst[j] = sum;
+    }
+}
+
+static void convolve_row_scalar(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_scalar_taps, taps, (src, weights, taps, dst, n));
+}
+
+static void accumulate_row_scalar(const double *src, double weight, double *acc, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        acc[j] += src[j] * weight;
+    }
+}
+
+static void add_row_scalar(const uint8_t *src, int32_t *sums, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        sums[j] += src[j];
+    }
+}
+
+static void subtract_row_scalar(const uint8_t *src, int32_t *sums, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        sums[j] -= src[j];
+    }
+}
+
+static void divide_row_scalar(const int32_t *sums, int divisor, uint8_t *dst, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        dst[j] = static_cast<uint8_t>(sums[j] / divisor);
+    }
+}
+
+// The fused kernels index the tap rows directly, so their tails go through
+// this range version rather than through offset pointers.
+template <int TAPS>
+static void unsharp_pixels_scalar_taps(const double *const *rows, const double *weights, int taps,
+                                       const uint8_t *original, double amount, uint8_t *dst, int first, int last)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = first; j < last; j++)
+    {
+        double sum = 0.0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += rows[t][j] * weights[t];
+        }
+        int edgeValue = original[j] - static_cast<uint8_t>(static_cast<int>(sum));
+        int sharpenedValue = static_cast<int>(original[j] + (amount * edgeValue));
+        sharpenedValue = (sharpenedValue < 0) ? 0 : (sharpenedValue > 255 ? 255 : sharpenedValue);
+        dst[j] = static_cast<uint8_t>(sharpenedValue);
+    }
+}
+
+static void unsharp_row_scalar(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                               double amount, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(unsharp_pixels_scalar_taps, taps, (rows, weights, taps, original, amount, dst, 0, n));
+}
+
+// Fixed-point Gaussian passes. Weights are Q14 and sum to 1 << 14.
+// Horizontal: Q0 pixels in, Q7 out, rounded half up.
+template <int TAPS>
+static void convolve_row_fixed_scalar_taps(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = 0; j < n; j++)
+    {
+        int32_t sum = 0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += src[j + t] * weights[t];
+        }
+        dst[j] = static_cast<int16_t>((sum + FIXED_ROW_ROUND) >> FIXED_ROW_SHIFT);
+    }
+}
+
+static void convolve_row_fixed_scalar(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_fixed_scalar_taps, taps, (src, weights, taps, dst, n));
+}
+
+// Vertical: Q7 rows in, Q0 pixels out, rounded half up.
+template <int TAPS>
+static void combine_rows_fixed_pixels_taps(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst,
+                                           int first, int last)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = first; j < last; j++)
+    {
+        int32_t sum = 0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += rows[t][j] * weights[t];
+        }
+        dst[j] = static_cast<uint8_t>((sum + FIXED_COLUMN_ROUND) >> FIXED_COLUMN_SHIFT);
+    }
+}
+
+static void combine_rows_fixed_scalar(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_fixed_pixels_taps, taps, (rows, weights, taps, dst, 0, n));
+}
+
+// Vertical pass of the double-precision Gaussian: weighted sum of the tap
+// rows, truncated towards zero.
+template <int TAPS>
+static void combine_rows_pixels_taps(const double *const *rows, const double *weights, int taps, uint8_t *dst,
+                                     int first, int last)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = first; j < last; j++)
+    {
+        double sum = 0.0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += rows[t][j] * weights[t];
+        }
+        dst[j] = static_cast<uint8_t>(static_cast<int>(sum));
+    }
+}
+
+static void combine_rows_scalar(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_pixels_taps, taps, (rows, weights, taps, dst, 0, n));
+}
+
+// combine_rows without the truncation: the weighted sums stay doubles.
+template <int TAPS>
+static void weighted_sum_pixels_taps(const double *const *rows, const double *weights, int taps, double *dst,
+                                     int first, int last)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    for (int j = first; j < last; j++)
+    {
+        double sum = 0.0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            sum += rows[t][j] * weights[t];
+        }
+        dst[j] = sum;
+    }
+}
+
+static void weighted_sum_rows_scalar(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(weighted_sum_pixels_taps, taps, (rows, weights, taps, dst, 0, n));
+}
+
+// Box sums as a running sum: two additions per pixel whatever the window.
+static void box_sum_running(const int32_t *sums, int window, int32_t *dst, int first, int last)
+{
+    int32_t sum = 0;
+    for (int t = 0; t < window - 1; t++)
+    {
+        sum += sums[first + t];
+    }
+    for (int j = first; j < last; j++)
+    {
+        sum += sums[j + window - 1];
+        dst[j] = sum;
+        sum -= sums[j];
+    }
+}
+
+// With the window known at compile time, the direct sum has no serial
+// dependency between pixels and vectorises; the integers are the same.
+template <int TAPS>
+static void box_sum_row_scalar_taps(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    if (TAPS == 0)
+    {
+        box_sum_running(sums, window, dst, 0, n);
+        return;
+    }
+    for (int j = 0; j < n; j++)
+    {
+        int32_t sum = 0;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < TAPS; t++)
+        {
+            sum += sums[j + t];
+        }
+        dst[j] = sum;
+    }
+}
+
+static void box_sum_row_scalar(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(box_sum_row_scalar_taps, window, (sums, window, dst, n));
+}
+
+static void recursive_row_scalar(const double *x, const double *w1, const double *w2, const double *w3,
+                                 const double *c, double *dst, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        dst[j] = c[0] * x[j] + c[1] * w1[j] + c[2] * w2[j] + c[3] * w3[j];
+    }
+}
+
+static void saturating_add_row_scalar(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        int sum = a[j] + b[j];
+        dst[j] = static_cast<uint8_t>(sum <= 255 ? sum : 255);
+    }
+}
+
+static void saturating_subtract_row_scalar(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        int difference = a[j] - b[j];
+        dst[j] = static_cast<uint8_t>(difference >= 0 ? difference : 0);
+    }
+}
+
+static void error_sums_row_scalar(const uint8_t *a, const uint8_t *b, int n, uint64_t *absolute, uint64_t *squared)
+{
+    uint64_t absoluteSum = 0;
+    uint64_t squaredSum = 0;
+    for (int j = 0; j < n; j++)
+    {
+        int difference = a[j] - b[j];
+        absoluteSum += difference < 0 ? -difference : difference;
+        squaredSum += difference * difference;
+    }
+    *absolute += absoluteSum;
+    *squared += squaredSum;
+}
+
+// The vector divide works on float estimates that are corrected by one step;
+// this is exact as long as every product involved stays below 2^24.
+static const int MAX_VECTOR_DIVISOR = 16384;
+
+#ifdef CLEARVISION_X86_64
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels (always available on x86-64)
+// ---------------------------------------------------------------------------
+
+static void widen_row_sse2(const uint8_t *src, double *dst, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j));
+        __m128i words = _mm_unpacklo_epi8(bytes, zero);
+        __m128i lo = _mm_unpacklo_epi16(words, zero);
+        __m128i hi = _mm_unpackhi_epi16(words, zero);
+        _mm_storeu_pd(dst + j, _mm_cvtepi32_pd(lo));
+        _mm_storeu_pd(dst + j + 2, _mm_cvtepi32_pd(_mm_srli_si128(lo, 8)));
+        _mm_storeu_pd(dst + j + 4, _mm_cvtepi32_pd(hi));
+        _mm_storeu_pd(dst + j + 6, _mm_cvtepi32_pd(_mm_srli_si128(hi, 8)));
+    }
+    widen_row_scalar(src + j, dst + j, n - j);
+}
+
+template <int TAPS>
+static void convolve_row_sse2_taps(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        __m128d sum0 = _mm_setzero_pd();
+        __m128d sum1 = _mm_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m128d w = _mm_set1_pd(weights[t]);
+            sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(src + j + t), w));
+            sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(src + j + t + 2), w));
+        }
+        _mm_storeu_pd(dst + j, sum0);
+        _mm_storeu_pd(dst + j + 2, sum1);
+    }
+    convolve_row_scalar(src + j, weights, taps, dst + j, n - j);
+}
+
+static void convolve_row_sse2(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_sse2_taps, taps, (src, weights, taps, dst, n));
+}
+
+static void accumulate_row_sse2(const double *src, double weight, double *acc, int n)
+{
+    __m128d w = _mm_set1_pd(weight);
+    int j = 0;
+    for (; j + 2 <= n; j += 2)
+    {
+        _mm_storeu_pd(acc + j, _mm_add_pd(_mm_loadu_pd(acc + j), _mm_mul_pd(_mm_loadu_pd(src + j), w)));
+    }
+    accumulate_row_scalar(src + j, weight, acc + j, n - j);
+}
+
+static void add_row_sse2(const uint8_t *src, int32_t *sums, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j)), zero);
+        __m128i *out = reinterpret_cast<__m128i *>(sums + j);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_unpacklo_epi16(words, zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(words, zero)));
+    }
+    add_row_scalar(src + j, sums + j, n - j);
+}
+
+static void subtract_row_sse2(const uint8_t *src, int32_t *sums, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j)), zero);
+        __m128i *out = reinterpret_cast<__m128i *>(sums + j);
+        _mm_storeu_si128(out, _mm_sub_epi32(_mm_loadu_si128(out), _mm_unpacklo_epi16(words, zero)));
+        _mm_storeu_si128(out + 1, _mm_sub_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(words, zero)));
+    }
+    subtract_row_scalar(src + j, sums + j, n - j);
+}
+
+// Quotients of four sums: a float estimate, then one correction step so the
+// result is exactly sum / divisor.
+static inline __m128i divide4_sse2(__m128i sums, __m128 divisor, __m128 reciprocal)
+{
+    __m128 s = _mm_cvtepi32_ps(sums);
+    __m128i q = _mm_cvttps_epi32(_mm_mul_ps(s, reciprocal));
+    __m128 product = _mm_mul_ps(_mm_cvtepi32_ps(q), divisor);
+    __m128i tooSmall = _mm_castps_si128(_mm_cmple_ps(_mm_add_ps(product, divisor), s));
+    __m128i tooLarge = _mm_castps_si128(_mm_cmpgt_ps(product, s));
+    return _mm_add_epi32(_mm_sub_epi32(q, tooSmall), tooLarge);
+}
+
+static void divide_row_sse2(const int32_t *sums, int divisor, uint8_t *dst, int n)
+{
+    int j = 0;
+    if (divisor <= MAX_VECTOR_DIVISOR)
+    {
+        const __m128 d = _mm_set1_ps(static_cast<float>(divisor));
+        const __m128 r = _mm_set1_ps(1.0f / divisor);
+        const __m128i lowByte = _mm_set1_epi32(0xFF);
+        for (; j + 8 <= n; j += 8)
+        {
+            // Keep only the low byte, like the scalar cast to uint8_t does.
+            __m128i a = _mm_and_si128(divide4_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + j)), d, r), lowByte);
+            __m128i b = _mm_and_si128(divide4_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + j + 4)), d, r), lowByte);
+            __m128i words = _mm_packs_epi32(a, b);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+        }
+    }
+    divide_row_scalar(sums + j, divisor, dst + j, n - j);
+}
+
+template <int TAPS>
+static void unsharp_row_sse2_taps(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                                  double amount, uint8_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128d a = _mm_set1_pd(amount);
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        __m128d sum0 = _mm_setzero_pd();
+        __m128d sum1 = _mm_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m128d w = _mm_set1_pd(weights[t]);
+            sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(rows[t] + j), w));
+            sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(rows[t] + j + 2), w));
+        }
+        __m128i blurred = _mm_unpacklo_epi64(_mm_cvttpd_epi32(sum0), _mm_cvttpd_epi32(sum1));
+
+        int32_t bytes;
+        std::memcpy(&bytes, original + j, sizeof(bytes));
+        __m128i o = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        __m128i edge = _mm_sub_epi32(o, blurred);
+        __m128d lo = _mm_add_pd(_mm_cvtepi32_pd(o), _mm_mul_pd(a, _mm_cvtepi32_pd(edge)));
+        __m128d hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(o, 8)),
+                                _mm_mul_pd(a, _mm_cvtepi32_pd(_mm_srli_si128(edge, 8))));
+
+        // Saturating packs clamp to 0 .. 255.
+        __m128i words = _mm_packs_epi32(_mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi)), zero);
+        bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        std::memcpy(dst + j, &bytes, sizeof(bytes));
+    }
+    unsharp_pixels_scalar_taps<TAPS>(rows, weights, taps, original, amount, dst, j, n);
+}
+
+static void unsharp_row_sse2(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                             double amount, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(unsharp_row_sse2_taps, taps, (rows, weights, taps, original, amount, dst, n));
+}
+
+// Two taps' weights side by side, for pmaddwd against interleaved samples
+static inline __m128i weight_pair_sse2(const int16_t *weights, int t, int taps)
+{
+    int16_t next = t + 1 < taps ? weights[t + 1] : 0;
+    return _mm_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(next)) << 16) |
+                                               static_cast<uint16_t>(weights[t])));
+}
+
+template <int TAPS>
+static void convolve_row_fixed_sse2_taps(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(FIXED_ROW_ROUND);
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i sum0 = round;
+        __m128i sum1 = round;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t += 2)
+        {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j + t)), zero);
+            __m128i b = t + 1 < count
+                            ? _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j + t + 1)), zero)
+                            : zero;
+            __m128i w = weight_pair_sse2(weights, t, count);
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        __m128i q7 = _mm_packs_epi32(_mm_srai_epi32(sum0, FIXED_ROW_SHIFT), _mm_srai_epi32(sum1, FIXED_ROW_SHIFT));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), q7);
+    }
+    convolve_row_fixed_scalar(src + j, weights, taps, dst + j, n - j);
+}
+
+static void convolve_row_fixed_sse2(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_fixed_sse2_taps, taps, (src, weights, taps, dst, n));
+}
+
+template <int TAPS>
+static void combine_rows_fixed_sse2_taps(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst,
+                                         int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(FIXED_COLUMN_ROUND);
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i sum0 = round;
+        __m128i sum1 = round;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t += 2)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[t] + j));
+            __m128i b = t + 1 < count ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[t + 1] + j)) : zero;
+            __m128i w = weight_pair_sse2(weights, t, count);
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        __m128i words = _mm_packs_epi32(_mm_srai_epi32(sum0, FIXED_COLUMN_SHIFT), _mm_srai_epi32(sum1, FIXED_COLUMN_SHIFT));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+    }
+    combine_rows_fixed_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void combine_rows_fixed_sse2(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_fixed_sse2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+static void combine_rows_sse2_taps(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128d sum[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m128d w = _mm_set1_pd(weights[t]);
+            for (int k = 0; k < 4; k++)
+            {
+                sum[k] = _mm_add_pd(sum[k], _mm_mul_pd(_mm_loadu_pd(rows[t] + j + 2 * k), w));
+            }
+        }
+        __m128i a = _mm_unpacklo_epi64(_mm_cvttpd_epi32(sum[0]), _mm_cvttpd_epi32(sum[1]));
+        __m128i b = _mm_unpacklo_epi64(_mm_cvttpd_epi32(sum[2]), _mm_cvttpd_epi32(sum[3]));
+        __m128i words = _mm_packs_epi32(a, b);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+    }
+    combine_rows_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void combine_rows_sse2(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_sse2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+static void weighted_sum_rows_sse2_taps(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128d sum[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m128d w = _mm_set1_pd(weights[t]);
+            for (int k = 0; k < 4; k++)
+            {
+                sum[k] = _mm_add_pd(sum[k], _mm_mul_pd(_mm_loadu_pd(rows[t] + j + 2 * k), w));
+            }
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            _mm_storeu_pd(dst + j + 2 * k, sum[k]);
+        }
+    }
+    weighted_sum_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void weighted_sum_rows_sse2(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(weighted_sum_rows_sse2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+static void box_sum_row_sse2_taps(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    if (TAPS == 0)
+    {
+        box_sum_running(sums, window, dst, 0, n);
+        return;
+    }
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i sum0 = _mm_setzero_si128();
+        __m128i sum1 = _mm_setzero_si128();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < TAPS; t++)
+        {
+            sum0 = _mm_add_epi32(sum0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + j + t)));
+            sum1 = _mm_add_epi32(sum1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + j + t + 4)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), sum0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j + 4), sum1);
+    }
+    box_sum_running(sums, window, dst, j, n);
+}
+
+static void box_sum_row_sse2(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(box_sum_row_sse2_taps, window, (sums, window, dst, n));
+}
+
+static void recursive_row_sse2(const double *x, const double *w1, const double *w2, const double *w3,
+                               const double *c, double *dst, int n)
+{
+    const __m128d c0 = _mm_set1_pd(c[0]), c1 = _mm_set1_pd(c[1]), c2 = _mm_set1_pd(c[2]), c3 = _mm_set1_pd(c[3]);
+    int j = 0;
+    for (; j + 2 <= n; j += 2)
+    {
+        __m128d sum = _mm_add_pd(_mm_mul_pd(c0, _mm_loadu_pd(x + j)), _mm_mul_pd(c1, _mm_loadu_pd(w1 + j)));
+        sum = _mm_add_pd(sum, _mm_mul_pd(c2, _mm_loadu_pd(w2 + j)));
+        _mm_storeu_pd(dst + j, _mm_add_pd(sum, _mm_mul_pd(c3, _mm_loadu_pd(w3 + j))));
+    }
+    recursive_row_scalar(x + j, w1 + j, w2 + j, w3 + j, c, dst + j, n - j);
+}
+
+// paddusb / psubusb: 16 clamped sums or differences per instruction
+static void saturating_add_row_sse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), _mm_adds_epu8(x, y));
+    }
+    saturating_add_row_scalar(a + j, b + j, dst + j, n - j);
+}
+
+static void saturating_subtract_row_sse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), _mm_subs_epu8(x, y));
+    }
+    saturating_subtract_row_scalar(a + j, b + j, dst + j, n - j);
+}
+
+// The vector loops below sum squares in 32-bit lanes; each 16-pixel step adds at
+// most 4 * 255^2 to a lane, so lanes are emptied into 64-bit totals this often.
+static const int ERROR_SUM_FLUSH = 1024;
+
+// |a - b| as the larger minus the smaller, summed 8 bytes at a time by psadbw;
+// squares of the 16-bit differences summed pairwise by pmaddwd
+static void error_sums_row_sse2(const uint8_t *a, const uint8_t *b, int n, uint64_t *absolute, uint64_t *squared)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i absoluteSums = zero;
+    uint64_t squaredSum = 0;
+    int j = 0;
+    while (j + 16 <= n)
+    {
+        __m128i squares = zero;
+        for (int step = 0; step < ERROR_SUM_FLUSH && j + 16 <= n; step++, j += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+            __m128i difference = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+            absoluteSums = _mm_add_epi64(absoluteSums, _mm_sad_epu8(difference, zero));
+            __m128i low = _mm_unpacklo_epi8(difference, zero);
+            __m128i high = _mm_unpackhi_epi8(difference, zero);
+            squares = _mm_add_epi32(squares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), squares);
+        squaredSum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), absoluteSums);
+    *absolute += sums[0] + sums[1];
+    *squared += squaredSum;
+    error_sums_row_scalar(a + j, b + j, n - j, absolute, squared);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels (selected only when CPUID reports AVX2)
+// ---------------------------------------------------------------------------
+
+CLEARVISION_TARGET_AVX2
+static void widen_row_avx2(const uint8_t *src, double *dst, int n)
+{
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j)));
+        _mm256_storeu_pd(dst + j, _mm256_cvtepi32_pd(_mm256_castsi256_si128(ints)));
+        _mm256_storeu_pd(dst + j + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(ints, 1)));
+    }
+    widen_row_scalar(src + j, dst + j, n - j);
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void convolve_row_avx2_taps(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m256d w = _mm256_set1_pd(weights[t]);
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(src + j + t), w));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(src + j + t + 4), w));
+        }
+        _mm256_storeu_pd(dst + j, sum0);
+        _mm256_storeu_pd(dst + j + 4, sum1);
+    }
+    convolve_row_scalar(src + j, weights, taps, dst + j, n - j);
+}
+
+static void convolve_row_avx2(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_avx2_taps, taps, (src, weights, taps, dst, n));
+}
+
+CLEARVISION_TARGET_AVX2
+static void accumulate_row_avx2(const double *src, double weight, double *acc, int n)
+{
+    __m256d w = _mm256_set1_pd(weight);
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        _mm256_storeu_pd(acc + j, _mm256_add_pd(_mm256_loadu_pd(acc + j), _mm256_mul_pd(_mm256_loadu_pd(src + j), w)));
+    }
+    accumulate_row_scalar(src + j, weight, acc + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void add_row_avx2(const uint8_t *src, int32_t *sums, int n)
+{
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j)));
+        __m256i *out = reinterpret_cast<__m256i *>(sums + j);
+        _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), ints));
+    }
+    add_row_scalar(src + j, sums + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void subtract_row_avx2(const uint8_t *src, int32_t *sums, int n)
+{
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j)));
+        __m256i *out = reinterpret_cast<__m256i *>(sums + j);
+        _mm256_storeu_si256(out, _mm256_sub_epi32(_mm256_loadu_si256(out), ints));
+    }
+    subtract_row_scalar(src + j, sums + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void divide_row_avx2(const int32_t *sums, int divisor, uint8_t *dst, int n)
+{
+    int j = 0;
+    if (divisor <= MAX_VECTOR_DIVISOR)
+    {
+        const __m256 d = _mm256_set1_ps(static_cast<float>(divisor));
+        const __m256 r = _mm256_set1_ps(1.0f / divisor);
+        const __m256i lowByte = _mm256_set1_epi32(0xFF);
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 s = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(sums + j)));
+            __m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(s, r));
+            __m256 product = _mm256_mul_ps(_mm256_cvtepi32_ps(q), d);
+            __m256i tooSmall = _mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(product, d), s, _CMP_LE_OQ));
+            __m256i tooLarge = _mm256_castps_si256(_mm256_cmp_ps(product, s, _CMP_GT_OQ));
+            q = _mm256_and_si256(_mm256_add_epi32(_mm256_sub_epi32(q, tooSmall), tooLarge), lowByte);
+
+            __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+        }
+    }
+    divide_row_scalar(sums + j, divisor, dst + j, n - j);
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void unsharp_row_avx2_taps(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                                  double amount, uint8_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m256d a = _mm256_set1_pd(amount);
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m256d w = _mm256_set1_pd(weights[t]);
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j), w));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j + 4), w));
+        }
+        __m256i blurred = _mm256_set_m128i(_mm256_cvttpd_epi32(sum1), _mm256_cvttpd_epi32(sum0));
+
+        __m256i o = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(original + j)));
+        __m256i edge = _mm256_sub_epi32(o, blurred);
+        __m256d lo = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(o)),
+                                   _mm256_mul_pd(a, _mm256_cvtepi32_pd(_mm256_castsi256_si128(edge))));
+        __m256d hi = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(o, 1)),
+                                   _mm256_mul_pd(a, _mm256_cvtepi32_pd(_mm256_extracti128_si256(edge, 1))));
+
+        // Saturating packs clamp to 0 .. 255.
+        __m128i words = _mm_packs_epi32(_mm256_cvttpd_epi32(lo), _mm256_cvttpd_epi32(hi));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+    }
+    unsharp_pixels_scalar_taps<TAPS>(rows, weights, taps, original, amount, dst, j, n);
+}
+
+static void unsharp_row_avx2(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                             double amount, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(unsharp_row_avx2_taps, taps, (rows, weights, taps, original, amount, dst, n));
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void convolve_row_fixed_avx2_taps(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(FIXED_ROW_ROUND);
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        // The 128-bit lanes hold pixels 0-7 and 8-15; unpacking and packing
+        // both stay within a lane, so the results come out in order.
+        __m256i sum0 = round;
+        __m256i sum1 = round;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t += 2)
+        {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + j + t)));
+            __m256i b = t + 1 < count
+                            ? _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + j + t + 1)))
+                            : zero;
+            __m256i w = _mm256_broadcastsi128_si256(weight_pair_sse2(weights, t, count));
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        __m256i q7 = _mm256_packs_epi32(_mm256_srai_epi32(sum0, FIXED_ROW_SHIFT), _mm256_srai_epi32(sum1, FIXED_ROW_SHIFT));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j), q7);
+    }
+    convolve_row_fixed_scalar(src + j, weights, taps, dst + j, n - j);
+}
+
+static void convolve_row_fixed_avx2(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(convolve_row_fixed_avx2_taps, taps, (src, weights, taps, dst, n));
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void combine_rows_fixed_avx2_taps(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst,
+                                         int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(FIXED_COLUMN_ROUND);
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256i sum0 = round;
+        __m256i sum1 = round;
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t += 2)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[t] + j));
+            __m256i b = t + 1 < count ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[t + 1] + j)) : zero;
+            __m256i w = _mm256_broadcastsi128_si256(weight_pair_sse2(weights, t, count));
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(sum0, FIXED_COLUMN_SHIFT),
+                                           _mm256_srai_epi32(sum1, FIXED_COLUMN_SHIFT));
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), bytes);
+    }
+    combine_rows_fixed_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void combine_rows_fixed_avx2(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_fixed_avx2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void combine_rows_avx2_taps(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m256d w = _mm256_set1_pd(weights[t]);
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j), w));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j + 4), w));
+        }
+        __m128i words = _mm_packs_epi32(_mm256_cvttpd_epi32(sum0), _mm256_cvttpd_epi32(sum1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+    }
+    combine_rows_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void combine_rows_avx2(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(combine_rows_avx2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void weighted_sum_rows_avx2_taps(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    const int count = TAPS > 0 ? TAPS : taps;
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < count; t++)
+        {
+            __m256d w = _mm256_set1_pd(weights[t]);
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j), w));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(rows[t] + j + 4), w));
+        }
+        _mm256_storeu_pd(dst + j, sum0);
+        _mm256_storeu_pd(dst + j + 4, sum1);
+    }
+    weighted_sum_pixels_taps<TAPS>(rows, weights, taps, dst, j, n);
+}
+
+static void weighted_sum_rows_avx2(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(weighted_sum_rows_avx2_taps, taps, (rows, weights, taps, dst, n));
+}
+
+template <int TAPS>
+CLEARVISION_TARGET_AVX2
+static void box_sum_row_avx2_taps(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    if (TAPS == 0)
+    {
+        box_sum_running(sums, window, dst, 0, n);
+        return;
+    }
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        CLEARVISION_UNROLL
+        for (int t = 0; t < TAPS; t++)
+        {
+            sum0 = _mm256_add_epi32(sum0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sums + j + t)));
+            sum1 = _mm256_add_epi32(sum1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sums + j + t + 8)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j), sum0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j + 8), sum1);
+    }
+    box_sum_running(sums, window, dst, j, n);
+}
+
+static void box_sum_row_avx2(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    CLEARVISION_DISPATCH_TAPS(box_sum_row_avx2_taps, window, (sums, window, dst, n));
+}
+
+CLEARVISION_TARGET_AVX2
+static void recursive_row_avx2(const double *x, const double *w1, const double *w2, const double *w3,
+                               const double *c, double *dst, int n)
+{
+    const __m256d c0 = _mm256_set1_pd(c[0]), c1 = _mm256_set1_pd(c[1]);
+    const __m256d c2 = _mm256_set1_pd(c[2]), c3 = _mm256_set1_pd(c[3]);
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        __m256d sum = _mm256_add_pd(_mm256_mul_pd(c0, _mm256_loadu_pd(x + j)), _mm256_mul_pd(c1, _mm256_loadu_pd(w1 + j)));
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(c2, _mm256_loadu_pd(w2 + j)));
+        _mm256_storeu_pd(dst + j, _mm256_add_pd(sum, _mm256_mul_pd(c3, _mm256_loadu_pd(w3 + j))));
+    }
+    recursive_row_scalar(x + j, w1 + j, w2 + j, w3 + j, c, dst + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void saturating_add_row_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + j));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j), _mm256_adds_epu8(x, y));
+    }
+    saturating_add_row_sse2(a + j, b + j, dst + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void saturating_subtract_row_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    int j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + j));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j), _mm256_subs_epu8(x, y));
+    }
+    saturating_subtract_row_sse2(a + j, b + j, dst + j, n - j);
+}
+
+CLEARVISION_TARGET_AVX2
+static void error_sums_row_avx2(const uint8_t *a, const uint8_t *b, int n, uint64_t *absolute, uint64_t *squared)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i absoluteSums = zero;
+    uint64_t squaredSum = 0;
+    int j = 0;
+    while (j + 32 <= n)
+    {
+        __m256i squares = zero;
+        for (int step = 0; step < ERROR_SUM_FLUSH && j + 32 <= n; step++, j += 32)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + j));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+            __m256i difference = _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+            absoluteSums = _mm256_add_epi64(absoluteSums, _mm256_sad_epu8(difference, zero));
+            __m256i low = _mm256_unpacklo_epi8(difference, zero);
+            __m256i high = _mm256_unpackhi_epi8(difference, zero);
+            squares = _mm256_add_epi32(squares,
+                                       _mm256_add_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high)));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), squares);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            squaredSum += lanes[lane];
+        }
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), absoluteSums);
+    *absolute += sums[0] + sums[1] + sums[2] + sums[3];
+    *squared += squaredSum;
+    error_sums_row_sse2(a + j, b + j, n - j, absolute, squared);
+}
+
+#endif // CLEARVISION_X86_64
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+
+struct RowKernels
+{
+    void (*widen_row)(const uint8_t *, double *, int);
+    void (*convolve_row)(const double *, const double *, int, double *, int);
+    void (*accumulate_row)(const double *, double, double *, int);
+    void (*add_row)(const uint8_t *, int32_t *, int);
+    void (*subtract_row)(const uint8_t *, int32_t *, int);
+    void (*divide_row)(const int32_t *, int, uint8_t *, int);
+    void (*unsharp_row)(const double *const *, const double *, int, const uint8_t *, double, uint8_t *, int);
+    void (*convolve_row_fixed)(const uint8_t *, const int16_t *, int, int16_t *, int);
+    void (*combine_rows_fixed)(const int16_t *const *, const int16_t *, int, uint8_t *, int);
+    void (*recursive_row)(const double *, const double *, const double *, const double *, const double *, double *, int);
+    void (*combine_rows)(const double *const *, const double *, int, uint8_t *, int);
+    void (*box_sum_row)(const int32_t *, int, int32_t *, int);
+    void (*saturating_add_row)(const uint8_t *, const uint8_t *, uint8_t *, int);
+    void (*saturating_subtract_row)(const uint8_t *, const uint8_t *, uint8_t *, int);
+    void (*error_sums_row)(const uint8_t *, const uint8_t *, int, uint64_t *, uint64_t *);
+    void (*weighted_sum_rows)(const double *const *, const double *, int, double *, int);
+};
+
+static const RowKernels scalarKernels = {
+    widen_row_scalar, convolve_row_scalar, accumulate_row_scalar,
+    add_row_scalar, subtract_row_scalar, divide_row_scalar, unsharp_row_scalar,
+    convolve_row_fixed_scalar, combine_rows_fixed_scalar, recursive_row_scalar,
+    combine_rows_scalar, box_sum_row_scalar,
+    saturating_add_row_scalar, saturating_subtract_row_scalar, error_sums_row_scalar,
+    weighted_sum_rows_scalar};
+
+#ifdef CLEARVISION_X86_64
+static const RowKernels sse2Kernels = {
+    widen_row_sse2, convolve_row_sse2, accumulate_row_sse2,
+    add_row_sse2, subtract_row_sse2, divide_row_sse2, unsharp_row_sse2,
+    convolve_row_fixed_sse2, combine_rows_fixed_sse2, recursive_row_sse2,
+    combine_rows_sse2, box_sum_row_sse2,
+    saturating_add_row_sse2, saturating_subtract_row_sse2, error_sums_row_sse2,
+    weighted_sum_rows_sse2};
+
+static const RowKernels avx2Kernels = {
+    widen_row_avx2, convolve_row_avx2, accumulate_row_avx2,
+    add_row_avx2, subtract_row_avx2, divide_row_avx2, unsharp_row_avx2,
+    convolve_row_fixed_avx2, combine_rows_fixed_avx2, recursive_row_avx2,
+    combine_rows_avx2, box_sum_row_avx2,
+    saturating_add_row_avx2, saturating_subtract_row_avx2, error_sums_row_avx2,
+    weighted_sum_rows_avx2};
+
+static const RowKernels *const kernelTables[] = {&scalarKernels, &sse2Kernels, &avx2Kernels};
+#else
+static const RowKernels *const kernelTables[] = {&scalarKernels, &scalarKernels, &scalarKernels};
+#endif
+
+// Level in use, or -1 until the first kernel call detects it.
+static std::atomic<int> currentLevel(-1);
+
+static const RowKernels &kernels()
+{
+    int level = currentLevel.load(std::memory_order_relaxed);
+    if (level < 0)
+    {
+        level = Simd::detect_level();
+        currentLevel.store(level, std::memory_order_relaxed);
+    }
+    return *kernelTables[level];
+}
+
+// Widest instruction set supported by this CPU
+Simd::Level Simd::detect_level()
+{
+#ifdef CLEARVISION_X86_64
+#if defined(_MSC_VER)
+    // AVX2 needs the CPU flag (leaf 7, EBX bit 5) and the OS saving YMM state.
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    if (osSavesYmm && (info[1] & (1 << 5)))
+    {
+        return AVX2;
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return AVX2;
+    }
+#endif
+    return SSE2;
+#else
+    return SCALAR;
+#endif
+}
+
+// Instruction set the kernels currently use
+Simd::Level Simd::active_level()
+{
+    kernels();
+    return static_cast<Level>(currentLevel.load(std::memory_order_relaxed));
+}
+
+// Force a narrower instruction set
+void Simd::set_level(Level level)
+{
+    Level supported = detect_level();
+    currentLevel.store(level < supported ? level : supported, std::memory_order_relaxed);
+}
+
+// Name of an instruction set level
+const char *Simd::level_name(Level level)
+{
+    switch (level)
+    {
+    case AVX2:
+        return "avx2";
+    case SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+void Simd::widen_row(const uint8_t *src, double *dst, int n)
+{
+    kernels().widen_row(src, dst, n);
+}
+
+void Simd::convolve_row(const double *src, const double *weights, int taps, double *dst, int n)
+{
+    kernels().convolve_row(src, weights, taps, dst, n);
+}
+
+void Simd::accumulate_row(const double *src, double weight, double *acc, int n)
+{
+    kernels().accumulate_row(src, weight, acc, n);
+}
+
+void Simd::add_row(const uint8_t *src, int32_t *sums, int n)
+{
+    kernels().add_row(src, sums, n);
+}
+
+void Simd::subtract_row(const uint8_t *src, int32_t *sums, int n)
+{
+    kernels().subtract_row(src, sums, n);
+}
+
+void Simd::divide_row(const int32_t *sums, int divisor, uint8_t *dst, int n)
+{
+    kernels().divide_row(sums, divisor, dst, n);
+}
+
+void Simd::unsharp_row(const double *const *rows, const double *weights, int taps, const uint8_t *original,
+                       double amount, uint8_t *dst, int n)
+{
+    kernels().unsharp_row(rows, weights, taps, original, amount, dst, n);
+}
+
+void Simd::convolve_row_fixed(const uint8_t *src, const int16_t *weights, int taps, int16_t *dst, int n)
+{
+    kernels().convolve_row_fixed(src, weights, taps, dst, n);
+}
+
+void Simd::combine_rows_fixed(const int16_t *const *rows, const int16_t *weights, int taps, uint8_t *dst, int n)
+{
+    kernels().combine_rows_fixed(rows, weights, taps, dst, n);
+}
+
+void Simd::recursive_row(const double *x, const double *w1, const double *w2, const double *w3, const double *c,
+                         double *dst, int n)
+{
+    kernels().recursive_row(x, w1, w2, w3, c, dst, n);
+}
+
+void Simd::combine_rows(const double *const *rows, const double *weights, int taps, uint8_t *dst, int n)
+{
+    kernels().combine_rows(rows, weights, taps, dst, n);
+}
+
+void Simd::weighted_sum_rows(const double *const *rows, const double *weights, int taps, double *dst, int n)
+{
+    kernels().weighted_sum_rows(rows, weights, taps, dst, n);
+}
+
+void Simd::box_sum_row(const int32_t *sums, int window, int32_t *dst, int n)
+{
+    kernels().box_sum_row(sums, window, dst, n);
+}
+
+void Simd::saturating_add_row(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    kernels().saturating_add_row(a, b, dst, n);
+}
+
+void Simd::saturating_subtract_row(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n)
+{
+    kernels().saturating_subtract_row(a, b, dst, n);
+}
+
+void Simd::error_sums_row(const uint8_t *a, const uint8_t *b, int n, uint64_t *absolute, uint64_t *squared)
+{
+    kernels().error_sums_row(a, b, n, absolute, squared);
+}
@@ -0,0 +1,95 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+
+// Row kernels behind the Filter inner loops. Each one exists as a portable
+// scalar loop and, on x86-64, as SSE2 and AVX2 versions; the widest version
+// the CPU supports is picked at runtime from CPUID. Every version performs
+// the same arithmetic in the same order (no FMA contraction), so the output
+// does not depend on which one runs.
+//
+// Kernels that loop over filter taps have fully unrolled versions for 3, 5, 7,
+// 9 and 11 taps, the kernel sizes most runs use; other tap counts take a
+// generic loop. The choice is made per call from the tap count.
+class Simd {
+public:
+    enum Level { SCALAR = 0, SSE2 = 1, AVX2 = 2 };
+
+    // Widest instruction set supported by this CPU (and this build)
+    static Level detect_level();
+
+    // Instruction set the kernels currently use. Defaults to detect_level().
+    static Level active_level();
+
+    // Force a narrower instruction set, e.g. to compare against SCALAR.
+    // Requests above detect_level() are clamped to it.
+    static void set_level(Level level);
+
+    // Name of an instruction set level, for diagnostics
+    static const char* level_name(Level level);
+
+    // dst[j] = src[j] converted to double
+    static void widen_row(const uint8_t* src, double* dst, int n);
+
+    // dst[j] = sum over t of src[j + t] * weights[t], summed for t = 0 .. taps-1
+    static void convolve_row(const double* src, const double* weights, int taps, double* dst, int n);
+
+    // dst[j] = sum over t of rows[t][j] * weights[t], truncated towards zero (the sums
+    // must already be in 0 .. 255): the vertical pass of the separable Gaussian,
+    // computed in registers in one sweep
+    static void combine_rows(const double* const* rows, const double* weights, int taps, uint8_t* dst, int n);
+
+    // combine_rows without the truncation: dst[j] = the weighted sum itself
+    static void weighted_sum_rows(const double* const* rows, const double* weights, int taps, double* dst, int n);
+
+    // acc[j] += src[j] * weight
+    static void accumulate_row(const double* src, double weight, double* acc, int n);
+
+    // sums[j] += src[j] / sums[j] -= src[j]
+    static void add_row(const uint8_t* src, int32_t* sums, int n);
+    static void subtract_row(const uint8_t* src, int32_t* sums, int n);
+
+    // dst[j] = sums[j] + sums[j + 1] + ... + sums[j + window - 1]
+    static void box_sum_row(const int32_t* sums, int window, int32_t* dst, int n);
+
+    // dst[j] = sums[j] / divisor, exact integer division of non-negative sums
+    static void divide_row(const int32_t* sums, int divisor, uint8_t* dst, int n);
+
+    // dst[j] = clamp(int(original[j] + amount * (original[j] - blurred[j])), 0, 255) with
+    // blurred[j] = truncate(sum over t of rows[t][j] * weights[t]), computed on the fly:
+    // the vertical blur pass, sharpening and clamping in one sweep over the row.
+    // dst may alias original.
+    static void unsharp_row(const double* const* rows, const double* weights, int taps, const uint8_t* original,
+                            double amount, uint8_t* dst, int n);
+
+    // Fixed-point weights are Q14: weight w stands for w / 2^14. Q14 rather than
+    // Q15 so that a weight of 1.0 still fits the signed 16-bit lanes of pmaddwd.
+    static const int FIXED_WEIGHT_BITS = 14;
+
+    // dst[j] = (sum over t of src[j + t] * weights[t] + 2^6) >> 7: the horizontal
+    // fixed-point pass, Q14 weights on 8-bit pixels giving Q7 results (pixel * 128),
+    // rounded half up. Sums stay below 255 * 2^14, well inside 32 bits.
+    static void convolve_row_fixed(const uint8_t* src, const int16_t* weights, int taps, int16_t* dst, int n);
+
+    // dst[j] = (sum over t of rows[t][j] * weights[t] + 2^20) >> 21: the vertical
+    // fixed-point pass, Q14 weights on Q7 rows giving 8-bit pixels, rounded half up.
+    // Weights must be non-negative and sum to 2^14, which keeps sums below 2^31.
+    static void combine_rows_fixed(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int n);
+
+    // dst[j] = min(a[j] + b[j], 255) / max(a[j] - b[j], 0): pixelwise image
+    // arithmetic. dst may alias a or b.
+    static void saturating_add_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n);
+    static void saturating_subtract_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n);
+
+    // *absolute += sum of |a[j] - b[j]|, *squared += sum of (a[j] - b[j])^2: the
+    // exact integer sums behind the error metrics
+    static void error_sums_row(const uint8_t* a, const uint8_t* b, int n, uint64_t* absolute, uint64_t* squared);
+
+    // dst[j] = c[0] * x[j] + c[1] * w1[j] + c[2] * w2[j] + c[3] * w3[j]: one step of a
+    // third-order recursive filter run across a row of independent lanes. dst may alias x.
+    static void recursive_row(const double* x, const double* w1, const double* w2, const double* w3, const double* c,
+                              double* dst, int n);
+};
+
+#endif // SIMD_H
@@ -0,0 +1,152 @@
+#include "ThreadPool.h"
+#include <memory>
+
+// Set while a thread is running a task, so nested loops run inline
+// instead of waiting on the pool they are part of.
+static thread_local bool insideTask = false;
+
+// Constructor: start threadCount - 1 workers; the caller is the last thread
+ThreadPool::ThreadPool(int threadCount)
+    : task(nullptr), taskCount(0), nextIndex(0), busyWorkers(0), generation(0), stopping(false)
+{
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+// Destructor: wake every worker and wait for it to exit
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+// Worker thread body: wait for a new job, help with it, report back
+void ThreadPool::worker_loop()
+{
+    unsigned long seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+
+        run_indices();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0)
+        {
+            jobDone.notify_all();
+        }
+    }
+}
+
+// Pull indices off the current job until it runs dry
+void ThreadPool::run_indices()
+{
+    insideTask = true;
+    for (int i = nextIndex.fetch_add(1); i < taskCount; i = nextIndex.fetch_add(1))
+    {
+        try
+        {
+            (*task)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    insideTask = false;
+}
+
+// Run task(i) for every i in [0, count)
+void ThreadPool::parallel_for(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    if (workers.empty() || count == 1 || insideTask)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        taskCount = count;
+        nextIndex.store(0);
+        busyWorkers = static_cast<int>(workers.size());
+        error = nullptr;
+        ++generation;
+    }
+    jobReady.notify_all();
+
+    run_indices();
+
+    std::exception_ptr failure;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [&] { return busyWorkers == 0; });
+        this->task = nullptr;
+        failure = error;
+        error = nullptr;
+    }
+
+    // Surface the first exception a task threw, as a plain loop would.
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
+
+static std::mutex sharedMutex;
+static std::unique_ptr<ThreadPool> sharedPool;
+static int sharedThreadCount = 0;
+
+// Pool shared by the filters
+ThreadPool &ThreadPool::shared()
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    if (!sharedPool)
+    {
+        int threadCount = sharedThreadCount;
+        if (threadCount <= 0)
+        {
+            threadCount = static_cast<int>(std::thread::hardware_concurrency());
+        }
+        sharedPool.reset(new ThreadPool(threadCount > 0 ? threadCount : 1));
+    }
+    return *sharedPool;
+}
+
+// Resize the shared pool; takes effect on the next call to shared()
+void ThreadPool::set_shared_thread_count(int threadCount)
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    sharedThreadCount = threadCount;
+    sharedPool.reset();
+}
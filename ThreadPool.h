@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run index-parallel loops. The thread that
+// calls parallel_for takes part in the work, so a pool of N threads keeps
+// N - 1 workers parked between jobs.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+
+    // Current job, guarded by mutex. Indices are handed out through nextIndex.
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    const std::function<void(int)>* task;
+    int taskCount;
+    std::atomic<int> nextIndex;
+    int busyWorkers;
+    unsigned long generation;
+    bool stopping;
+
+    // First exception thrown by a task of the current job
+    std::exception_ptr error;
+
+    // Only one parallel_for runs at a time.
+    std::mutex jobMutex;
+
+    // Worker thread body
+    void worker_loop();
+
+    // Pull indices off the current job until it runs dry
+    void run_indices();
+
+public:
+    // Constructor: pool that runs loops on threadCount threads (at least 1)
+    explicit ThreadPool(int threadCount);
+
+    // Destructor: joins all workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads loops run on, the calling thread included
+    int get_thread_count() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run task(i) for every i in [0, count) and return once all calls finished.
+    // Calls made from inside a task run inline on the calling worker.
+    void parallel_for(int count, const std::function<void(int)>& task);
+
+    // Pool shared by the filters; sized to the hardware unless set_shared_thread_count was called
+    static ThreadPool& shared();
+
+    // Resize the shared pool (0 = one thread per hardware core). Call it
+    // between filter runs, not while another thread is using the pool.
+    static void set_shared_thread_count(int threadCount);
+};
+
+#endif // THREAD_POOL_H
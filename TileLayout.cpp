@@ -0,0 +1,129 @@
+#include "TileLayout.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Narrowest tile worth making: every tile re-reads padSize columns on either
+// side, so narrower tiles would spend too much of their time on halos.
+static const int MIN_TILE_WIDTH = 256;
+
+// Tiles per thread when the image has to be split for parallelism, so that a
+// thread that finishes early can pick up another one
+static const int TILES_PER_THREAD = 4;
+
+// Cache sizes set with set_cache_sizes, 0 when unset
+static std::atomic<int> l1Override(0);
+static std::atomic<int> l2Override(0);
+
+// Cache sizes assumed when the system does not report them
+static const int DEFAULT_L1_SIZE = 32 * 1024;
+static const int DEFAULT_L2_SIZE = 256 * 1024;
+
+// Size of the level 1 data cache or the level 2 cache as the system reports
+// it, 0 when it cannot tell
+static long system_cache_size(int level)
+{
+#if defined(_WIN32)
+    DWORD bytes = 0;
+    GetLogicalProcessorInformation(nullptr, &bytes);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> entries(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (entries.empty() || !GetLogicalProcessorInformation(entries.data(), &bytes))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const CACHE_DESCRIPTOR &cache = entries[i].Cache;
+        if (entries[i].Relationship == RelationCache && cache.Level == level && cache.Type != CacheInstruction)
+        {
+            return static_cast<long>(cache.Size);
+        }
+    }
+    return 0;
+#elif defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    return sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+#else
+    return 0;
+#endif
+}
+
+// Ask the system for a cache size, falling back to fallback when it cannot tell
+static int detect_cache_size(int level, int fallback)
+{
+    long size = system_cache_size(level);
+    return size > 0 ? static_cast<int>(std::min(size, 1L << 30)) : fallback;
+}
+
+int TileLayout::l1_cache_size()
+{
+    if (l1Override > 0)
+    {
+        return l1Override;
+    }
+    static const int detected = detect_cache_size(1, DEFAULT_L1_SIZE);
+    return detected;
+}
+
+int TileLayout::l2_cache_size()
+{
+    if (l2Override > 0)
+    {
+        return l2Override;
+    }
+    static const int detected = detect_cache_size(2, DEFAULT_L2_SIZE);
+    return detected;
+}
+
+void TileLayout::set_cache_sizes(int l1Bytes, int l2Bytes)
+{
+    l1Override = std::max(0, l1Bytes);
+    l2Override = std::max(0, l2Bytes);
+}
+
+std::vector<Tile> TileLayout::split(int width, int height, int windowSize, int rowBytes, int ringBytes)
+{
+    std::vector<Tile> tiles;
+    if (width <= 0 || height <= 0)
+    {
+        return tiles;
+    }
+
+    // Widest tile whose row scratch fills at most half of L1 and whose ring
+    // fills at most half of L2, leaving room for the image rows streaming
+    // through. Columns are then spread evenly over the strips.
+    int fitL1 = l1_cache_size() / 2 / std::max(1, rowBytes);
+    int fitL2 = l2_cache_size() / 2 / std::max(1, ringBytes);
+    int tileWidth = std::max(MIN_TILE_WIDTH, std::min(fitL1, fitL2));
+    int strips = (width + tileWidth - 1) / tileWidth;
+
+    // Split rows only as far as the threads need; every band re-reads
+    // windowSize - 1 rows around it, so bands stay at least 8 windows tall.
+    int threads = ThreadPool::shared().get_thread_count();
+    int bands = 1;
+    if (threads > 1)
+    {
+        int wanted = (TILES_PER_THREAD * threads + strips - 1) / strips;
+        bands = std::max(1, std::min(wanted, height / (8 * std::max(1, windowSize))));
+    }
+
+    for (int band = 0; band < bands; band++)
+    {
+        for (int strip = 0; strip < strips; strip++)
+        {
+            Tile tile;
+            tile.firstRow = static_cast<int>(static_cast<long>(height) * band / bands);
+            tile.lastRow = static_cast<int>(static_cast<long>(height) * (band + 1) / bands);
+            tile.firstColumn = static_cast<int>(static_cast<long>(width) * strip / strips);
+            tile.lastColumn = static_cast<int>(static_cast<long>(width) * (strip + 1) / strips);
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,36 @@
+#ifndef TILE_LAYOUT_H
+#define TILE_LAYOUT_H
+
+#include <vector>
+
+// Rectangle of an image: rows [firstRow, lastRow), columns [firstColumn, lastColumn)
+struct Tile {
+    int firstRow, lastRow;
+    int firstColumn, lastColumn;
+};
+
+// How the streaming filters cut an image into tiles, their unit of parallel
+// work. A filter walks down a tile keeping a ring of windowSize rows as wide
+// as the tile, so the tile width is what decides whether its working set
+// stays in cache: tiles are made narrow enough for one row's scratch to fit
+// in L1 and the whole ring in L2. The tile height does not change the working
+// set; rows are only split further to give every thread a few tiles.
+class TileLayout {
+public:
+    // Split a width x height image for a filter of the given window size that
+    // keeps rowBytes bytes of per-row scratch and ringBytes bytes of ring for
+    // every column of a tile. Tiles are listed band by band, left to right.
+    static std::vector<Tile> split(int width, int height, int windowSize, int rowBytes, int ringBytes);
+
+    // Data cache sizes the tiles are sized for, in bytes: the ones set with
+    // set_cache_sizes, or else what the system reports (32 KiB and 256 KiB if
+    // it reports nothing)
+    static int l1_cache_size();
+    static int l2_cache_size();
+
+    // Override the detected cache sizes (0 = detect again). Call it between
+    // filter runs, like ThreadPool::set_shared_thread_count.
+    static void set_cache_sizes(int l1Bytes, int l2Bytes);
+};
+
+#endif // TILE_LAYOUT_H
@@ -1,8 +1,13 @@
 #include "GrayscaleImage.h"
 #include "SecretImage.h"
 #include "Filter.h"
+#include "Metrics.h"
 #include "Crypto.h"
+#include "ThreadPool.h"
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -13,18 +18,49 @@ std::string remove_extension(const std::string& filename) {
     return (last_dot != std::string::npos && last_dot > 0) ? filename.substr(0, last_dot) : filename;
 }
 
+// Border mode used by the filter operations, set with --border
+static BorderMode border_mode = BORDER_ZERO;
+
+// Parses a --border argument
+BorderMode parse_border_mode(const std::string& name) {
+    if (name == "zero") return BORDER_ZERO;
+    if (name == "replicate") return BORDER_REPLICATE;
+    if (name == "reflect") return BORDER_REFLECT;
+    if (name == "wrap") return BORDER_WRAP;
+    throw std::invalid_argument("Unknown border mode: " + name + " (zero, replicate, reflect or wrap)");
+}
+
+// Arithmetic used by the gauss operation, set with --gaussian
+static GaussianMode gaussian_mode = GAUSSIAN_EXACT;
+
+// Parses a --gaussian argument
+GaussianMode parse_gaussian_mode(const std::string& name) {
+    if (name == "exact") return GAUSSIAN_EXACT;
+    if (name == "fixed") return GAUSSIAN_FIXED;
+    if (name == "iir") return GAUSSIAN_IIR;
+    throw std::invalid_argument("Unknown gaussian mode: " + name + " (exact, fixed or iir)");
+}
+
 // Applies a mean filter to the input image and saves the result
 void apply_mean_filter(const char* input_image, int kernel_size) {
     GrayscaleImage img(input_image);
-    Filter::apply_mean_filter(img, kernel_size);
+    Filter::apply_mean_filter(img, kernel_size, border_mode);
     std::string output_filename = "mean_filtered_" + remove_extension(input_image) + "_" + std::to_string(kernel_size) + ".png";
     img.save_to_file(output_filename.c_str());
 }
 
+// Applies a median filter to the input image and saves the result
+void apply_median_filter(const char* input_image, int kernel_size) {
+    GrayscaleImage img(input_image);
+    Filter::apply_median_filter(img, kernel_size, border_mode);
+    std::string output_filename = "median_filtered_" + remove_extension(input_image) + "_" + std::to_string(kernel_size) + ".png";
+    img.save_to_file(output_filename.c_str());
+}
+
 // Applies Gaussian smoothing to the input image and saves the result
 void apply_gaussian_smoothing(const char* input_image, int kernel_size, double sigma) {
     GrayscaleImage img(input_image);
-    Filter::apply_gaussian_smoothing(img, kernel_size, sigma);
+    Filter::apply_gaussian_smoothing(img, kernel_size, sigma, border_mode, gaussian_mode);
     std::string output_filename = "gaussian_filtered_" + remove_extension(input_image) + "_" + std::to_string(kernel_size) + "_" + std::to_string(sigma) + ".png";
     img.save_to_file(output_filename.c_str());
 }
@@ -32,7 +68,7 @@ void apply_gaussian_smoothing(const char* input_image, int kernel_size, double s
 // Applies an unsharp mask to the input image to enhance sharpness and saves the result
 void apply_unsharp_mask(const char* input_image, int kernel_size, double amount) {
     GrayscaleImage img(input_image);
-    Filter::apply_unsharp_mask(img, kernel_size, amount);
+    Filter::apply_unsharp_mask(img, kernel_size, amount, border_mode);
     std::string output_filename = "unsharp_filtered_" + remove_extension(input_image) + "_" + std::to_string(kernel_size) + "_" + std::to_string(amount) + ".png";
     img.save_to_file(output_filename.c_str());
 }
@@ -53,11 +89,148 @@ void subtract_images(const char* img1, const char* img2) {
     result.save_to_file(output_filename.c_str());
 }
 
-// Compares two images and prints whether they are identical
-void compare_images(const char* img1, const char* img2) {
+// Reads a whole file into memory; false if it cannot be read
+bool read_file(const char* filename, std::string& contents) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+// Compares two images and prints whether they are identical. Byte-identical
+// files are equal without being decoded. With a tile size, also lists the
+// tiles that differ and the bounding box of the differences in each.
+void compare_images(const char* img1, const char* img2, int tile_size) {
+    std::string bytes1, bytes2;
+    if (tile_size == 0 && read_file(img1, bytes1) && read_file(img2, bytes2) && bytes1 == bytes2) {
+        std::cout << "Images are equal." << std::endl;
+        return;
+    }
+
     GrayscaleImage image1(img1), image2(img2);
     bool are_equal = (image1 == image2);
     std::cout << (are_equal ? "Images are equal." : "Images are not equal.") << std::endl;
+    if (are_equal || tile_size == 0) return;
+
+    if (image1.get_width() != image2.get_width() || image1.get_height() != image2.get_height()) {
+        std::cout << "Sizes differ: " << image1.get_width() << "x" << image1.get_height() << " vs "
+                  << image2.get_width() << "x" << image2.get_height() << std::endl;
+        return;
+    }
+    std::vector<TileDifference> tiles = GrayscaleImage::compare_tiles(image1, image2, tile_size);
+    for (size_t t = 0; t < tiles.size(); t++) {
+        const TileDifference& tile = tiles[t];
+        std::cout << "Tile (" << tile.tileRow << ", " << tile.tileColumn << "): rows " << tile.firstRow << "-"
+                  << tile.lastRow << ", columns " << tile.firstColumn << "-" << tile.lastColumn << ", "
+                  << tile.pixels << " pixels differ" << std::endl;
+    }
+}
+
+// Prints how far the second image is from the first: MAE, MSE, PSNR and SSIM
+void compare_metrics(const char* img1, const char* img2, const std::string& window) {
+    SsimWindow ssim_window;
+    if (window == "gaussian") ssim_window = SSIM_GAUSSIAN;
+    else if (window == "box") ssim_window = SSIM_BOX;
+    else throw std::invalid_argument("Unknown SSIM window: " + window + " (gaussian or box)");
+
+    GrayscaleImage image1(img1), image2(img2);
+    ImageComparison comparison = Metrics::compare(image1, image2, ssim_window);
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << "MAE: " << comparison.meanAbsoluteError << std::endl;
+    std::cout << "MSE: " << comparison.meanSquaredError << std::endl;
+    std::cout << "PSNR: " << comparison.psnr << " dB" << std::endl;
+    std::cout << "SSIM: " << comparison.ssim << std::endl;
+}
+
+// Prints the 64-bit content hash of an image, for comparing against stored hashes
+void hash_image(const char* input_image) {
+    GrayscaleImage img(input_image);
+    std::cout << std::hex << std::setw(16) << std::setfill('0') << img.content_hash() << std::dec << std::endl;
+}
+
+// One stage of a pipe command: an operation and its arguments
+struct PipeStage {
+    std::string operation;
+    std::vector<std::string> args;
+};
+
+// Number of arguments a pipe stage takes, or -1 for an unknown operation
+int pipe_stage_arity(const std::string& operation) {
+    if (operation == "mean" || operation == "median" || operation == "add" || operation == "sub") return 1;
+    if (operation == "gauss" || operation == "unsharp") return 2;
+    return -1;
+}
+
+// Splits the stage list of a pipe command (everything between the input and the output)
+std::vector<PipeStage> parse_pipe_stages(char** first, char** last) {
+    std::vector<PipeStage> stages;
+    while (first != last) {
+        PipeStage stage;
+        stage.operation = *first++;
+        int arity = pipe_stage_arity(stage.operation);
+        if (arity < 0) throw std::invalid_argument("Unknown pipe stage: " + stage.operation + " (mean, median, gauss, unsharp, add or sub)");
+        if (last - first < arity) throw std::invalid_argument("Missing arguments for pipe stage: " + stage.operation);
+        stage.args.assign(first, first + arity);
+        first += arity;
+        stages.push_back(stage);
+    }
+    return stages;
+}
+
+// Applies a run of add and sub stages in a single pass: each row takes every
+// operand in turn while it is still in cache, instead of the whole image
+// being traversed once per stage.
+void apply_pixel_stages(GrayscaleImage& img, std::vector<PipeStage>::const_iterator first,
+                        std::vector<PipeStage>::const_iterator last) {
+    std::vector<GrayscaleImage> operands;
+    for (std::vector<PipeStage>::const_iterator stage = first; stage != last; ++stage) {
+        operands.push_back(GrayscaleImage(stage->args[0].c_str()));
+        if (operands.back().get_width() != img.get_width() || operands.back().get_height() != img.get_height()) {
+            throw std::invalid_argument("ERROR: IMAGE DIMENSIONS DO NOT MATCH.");
+        }
+    }
+    int width = img.get_width();
+    ThreadPool::shared().parallel_for(img.get_height(), [&](int row) {
+        GrayscaleView pixels = img.view(row, 0, 1, width);
+        for (size_t k = 0; k < operands.size(); k++) {
+            ConstGrayscaleView operand = operands[k].view(row, 0, 1, width);
+            if (first[k].operation == "add") {
+                GrayscaleImage::add(pixels, operand, pixels);
+            } else {
+                GrayscaleImage::subtract(pixels, operand, pixels);
+            }
+        }
+    });
+}
+
+// Runs a chain of operations on one image and saves only the final result.
+// The image is decoded once and every stage works on it in place, so no
+// intermediate PNGs are written and no per-stage image copies are made.
+void run_pipe(const char* input_image, const std::vector<PipeStage>& stages, const char* output_image) {
+    GrayscaleImage img(input_image);
+    for (std::vector<PipeStage>::const_iterator stage = stages.begin(); stage != stages.end();) {
+        const std::vector<std::string>& args = stage->args;
+        if (stage->operation == "add" || stage->operation == "sub") {
+            std::vector<PipeStage>::const_iterator run = stage;
+            while (run != stages.end() && (run->operation == "add" || run->operation == "sub")) ++run;
+            apply_pixel_stages(img, stage, run);
+            stage = run;
+            continue;
+        }
+        if (stage->operation == "mean") {
+            Filter::apply_mean_filter(img, std::stoi(args[0]), border_mode);
+        } else if (stage->operation == "median") {
+            Filter::apply_median_filter(img, std::stoi(args[0]), border_mode);
+        } else if (stage->operation == "gauss") {
+            Filter::apply_gaussian_smoothing(img, std::stoi(args[0]), std::stof(args[1]), border_mode, gaussian_mode);
+        } else {
+            Filter::apply_unsharp_mask(img, std::stoi(args[0]), std::stof(args[1]), border_mode);
+        }
+        ++stage;
+    }
+    img.save_to_file(output_image);
 }
 
 // Converts a GrayscaleImage to a SecretImage and saves it in a disguised format
@@ -93,17 +266,46 @@ void decrypt_image(const char* input_image, int message_length) {
 }
 
 int main(int argc, char** argv) {
+    // Pull global options out of the argument list; the rest is <operation> <args>
+    std::vector<char*> args;
+    try {
+        for (int i = 0; i < argc; i++) {
+            if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+                ThreadPool::set_shared_thread_count(std::stoi(argv[++i]));
+                continue;
+            }
+            if (std::string(argv[i]) == "--border" && i + 1 < argc) {
+                border_mode = parse_border_mode(argv[++i]);
+                continue;
+            }
+            if (std::string(argv[i]) == "--gaussian" && i + 1 < argc) {
+                gaussian_mode = parse_gaussian_mode(argv[++i]);
+                continue;
+            }
+            args.push_back(argv[i]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
     // Check if enough arguments are provided
     if (argc < 2) {
         throw std::invalid_argument(
-            "Usage: clearvision <operation> <arg1> <arg2> .. \n"
+            "Usage: clearvision [--threads N] [--border zero|replicate|reflect|wrap] [--gaussian exact|fixed|iir] <operation> <arg1> <arg2> .. \n"
             "Modes of operation: \n\n"
             "clearvision mean <img> <kernel_size> \n"
+            "clearvision median <img> <kernel_size> \n"
             "clearvision gauss <img> <kernel_size> <sigma> \n"
             "clearvision unsharp <img> <kernel_size> <amount> \n"
             "clearvision add <img1> <img2> \n"
             "clearvision sub <img1> <img2> \n"
-            "clearvision equals <img1> <img2> \n"
+            "clearvision equals <img1> <img2> [tile_size] \n"
+            "clearvision compare <img1> <img2> [gaussian|box] \n"
+            "clearvision hash <img> \n"
+            "clearvision pipe <img> <stage> [<stage> ..] <out> \n"
             "clearvision disguise <img> <msg> \n"
             "clearvision reveal <img> <msg> \n"
             "clearvision enc <img> <msg> \n"
@@ -119,6 +321,10 @@ int main(int argc, char** argv) {
             if (argc < 4) throw std::invalid_argument("Usage: clearvision mean <img> <kernel_size>");
             apply_mean_filter(argv[2], std::stoi(argv[3]));
 
+        } else if (operation == "median") {
+            if (argc < 4) throw std::invalid_argument("Usage: clearvision median <img> <kernel_size>");
+            apply_median_filter(argv[2], std::stoi(argv[3]));
+
         } else if (operation == "gauss") {
             if (argc < 5) throw std::invalid_argument("Usage: clearvision gauss <img> <kernel_size> <sigma>");
             apply_gaussian_smoothing(argv[2], std::stoi(argv[3]), std::stof(argv[4]));
@@ -136,8 +342,21 @@ int main(int argc, char** argv) {
             subtract_images(argv[2], argv[3]);
 
         } else if (operation == "equals") {
-            if (argc < 4) throw std::invalid_argument("Usage: clearvision equals <img1> <img2>");
-            compare_images(argv[2], argv[3]);
+            if (argc < 4) throw std::invalid_argument("Usage: clearvision equals <img1> <img2> [tile_size]");
+            compare_images(argv[2], argv[3], argc > 4 ? std::stoi(argv[4]) : 0);
+
+        } else if (operation == "compare") {
+            if (argc < 4) throw std::invalid_argument("Usage: clearvision compare <img1> <img2> [gaussian|box]");
+            compare_metrics(argv[2], argv[3], argc > 4 ? argv[4] : "gaussian");
+
+        } else if (operation == "hash") {
+            if (argc < 3) throw std::invalid_argument("Usage: clearvision hash <img>");
+            hash_image(argv[2]);
+
+        } else if (operation == "pipe") {
+            if (argc < 5) throw std::invalid_argument("Usage: clearvision pipe <img> <stage> [<stage> ..] <out>\n"
+                                                      "Stages: mean <k>, median <k>, gauss <k> <sigma>, unsharp <k> <amount>, add <img>, sub <img>");
+            run_pipe(argv[2], parse_pipe_stages(argv + 3, argv + argc - 1), argv[argc - 1]);
 
         } else if (operation == "disguise") {
             if (argc < 3) throw std::invalid_argument("Usage: clearvision disguise <img>");
@@ -0,0 +1,376 @@
+// Checks ContentHash against reference XXH64 values, whole and streamed in
+// pieces; that an image's cached content_hash() is dropped by every way of
+// changing its pixels, including moving them out; that operator== gives the
+// exact answer whether or not the hashes are known; and compare_tiles
+// against a pixel-by-pixel count of the differences in each tile.
+//
+// Usage: test_content_hash <sample_io directory>
+
+#include "ContentHash.h"
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct HashVector
+{
+    std::string input;
+    uint64_t seed;
+    uint64_t expected;
+};
+
+struct Change
+{
+    const char *name;
+    std::function<void(GrayscaleImage &)> apply;
+};
+
+// Bytes 0 .. 255 followed by 0 .. 43: several 32-byte stripes and a tail of
+// every size class
+static std::string counting_bytes()
+{
+    std::string bytes;
+    for (int i = 0; i < 300; i++)
+    {
+        bytes += static_cast<char>(i % 256);
+    }
+    return bytes;
+}
+
+// Values of the reference XXH64
+static const HashVector VECTORS[] = {
+    {"", 0, 0xef46db3751d8e999ULL},
+    {"a", 0, 0xd24ec4f1a98c6e5bULL},
+    {"abc", 0, 0x44bc2cf5ad770999ULL},
+    {"abc", 0x9e3779b97f4a7c15ULL, 0x2ed0f59d6b43ac8bULL},
+    {"Nobody inspects the spammish repetition", 0, 0xfbcea83c8a378bf1ULL},
+    {counting_bytes(), 0, 0x4f1d6de0165b155aULL},
+};
+
+// Piece sizes the streamed input is fed in
+static const size_t PIECES[] = {1, 7, 31, 32, 33};
+
+// content_hash() of a 3 x 2 image with rows {0, 1, 2} and {10, 20, 30}, and of
+// an empty one: XXH64 of the width and height as 32-bit integers followed by
+// the pixels
+static const uint64_t SMALL_IMAGE_HASH = 0xa1d64c1a74201ab3ULL;
+static const uint64_t EMPTY_IMAGE_HASH = 0x34c96acdcadb1bbbULL;
+
+static int check_vectors()
+{
+    int failures = 0;
+    for (const HashVector &vector : VECTORS)
+    {
+        ContentHash whole(vector.seed);
+        whole.update(vector.input.data(), vector.input.size());
+        if (whole.digest() != vector.expected)
+        {
+            std::cerr << "FAIL XXH64 of " << vector.input.size() << " bytes, seed " << vector.seed << std::endl;
+            failures++;
+        }
+        for (size_t piece : PIECES)
+        {
+            ContentHash streamed(vector.seed);
+            for (size_t offset = 0; offset < vector.input.size(); offset += piece)
+            {
+                streamed.update(vector.input.data() + offset, std::min(piece, vector.input.size() - offset));
+            }
+            if (streamed.digest() != vector.expected)
+            {
+                std::cerr << "FAIL XXH64 of " << vector.input.size() << " bytes fed " << piece << " at a time"
+                          << std::endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+// Random pixels, the same on every run
+static GrayscaleImage random_image(int width, int height, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, static_cast<uint8_t>(pixel(generator)));
+        }
+    }
+    return image;
+}
+
+// The hash content_hash() should return, computed afresh through const access
+static uint64_t fresh_hash(const GrayscaleImage &image)
+{
+    ContentHash content;
+    int32_t dimensions[2] = {image.get_width(), image.get_height()};
+    content.update(dimensions, sizeof(dimensions));
+    for (int i = 0; i < image.get_height(); i++)
+    {
+        content.update(image.get_row(i), image.get_width());
+    }
+    return content.digest();
+}
+
+static int check_image_hashes(std::mt19937 &generator)
+{
+    int failures = 0;
+
+    GrayscaleImage small(3, 2);
+    const uint8_t values[2][3] = {{0, 1, 2}, {10, 20, 30}};
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            small.set_pixel(i, j, values[i][j]);
+        }
+        // Row padding is not part of the content.
+        for (int j = 3; j < small.get_stride(); j++)
+        {
+            small.get_row(i)[j] = static_cast<uint8_t>(j);
+        }
+    }
+    if (small.content_hash() != SMALL_IMAGE_HASH)
+    {
+        std::cerr << "FAIL content_hash of the 3x2 image" << std::endl;
+        failures++;
+    }
+
+    // Every change must drop the cached hash. The image is hashed first, so
+    // a change that is not noticed leaves the old value behind.
+    std::vector<Change> changes = {
+        {"set_pixel", [](GrayscaleImage &image) { image.set_pixel(1, 2, image.get_pixel(1, 2) ^ 1); }},
+        {"get_row", [](GrayscaleImage &image) { image.get_row(3)[0] ^= 1; }},
+        {"view", [](GrayscaleImage &image) { image.view(2, 2, 3, 3).get_row(1)[1] ^= 1; }},
+        {"get_data", [](GrayscaleImage &image) { image.get_data()[4][5] ^= 1; }},
+        {"fill", [](GrayscaleImage &image) { image.fill(7); }},
+        {"mean filter", [](GrayscaleImage &image) { Filter::apply_mean_filter(image, 5); }},
+        {"gaussian", [](GrayscaleImage &image) { Filter::apply_gaussian_smoothing(image, 5, 1.0); }},
+        {"median filter", [](GrayscaleImage &image) { Filter::apply_median_filter(image, 3); }},
+        {"+=", [](GrayscaleImage &image) { image += GrayscaleImage(image); }},
+        {"expression", [](GrayscaleImage &image) {
+             GrayscaleImage copy = image;
+             image = copy + copy - image;
+         }},
+        {"copy assignment", [&](GrayscaleImage &image) { image = random_image(31, 17, generator); }},
+        {"move assignment", [&](GrayscaleImage &image) {
+             GrayscaleImage other = random_image(31, 17, generator);
+             other.content_hash();
+             image = std::move(other);
+         }},
+    };
+    for (const Change &change : changes)
+    {
+        GrayscaleImage image = random_image(31, 17, generator);
+        uint64_t before = image.content_hash();
+        change.apply(image);
+        if (image.content_hash() != fresh_hash(image) || image.content_hash() == before)
+        {
+            std::cerr << "FAIL content_hash after " << change.name << " is stale" << std::endl;
+            failures++;
+        }
+    }
+
+    // Moving an image out leaves an empty one, with the empty image's hash.
+    GrayscaleImage source = random_image(31, 17, generator);
+    source.content_hash();
+    GrayscaleImage moved(std::move(source));
+    if (source.content_hash() != EMPTY_IMAGE_HASH || moved.content_hash() != fresh_hash(moved))
+    {
+        std::cerr << "FAIL content_hash after a move construction" << std::endl;
+        failures++;
+    }
+    GrayscaleImage assignedFrom = random_image(31, 17, generator);
+    assignedFrom.content_hash();
+    moved = std::move(assignedFrom);
+    if (assignedFrom.content_hash() != EMPTY_IMAGE_HASH || moved.content_hash() != fresh_hash(moved))
+    {
+        std::cerr << "FAIL content_hash after a move assignment" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// operator== has to agree with a pixel comparison whichever hashes are known
+static int check_equality(std::mt19937 &generator)
+{
+    int failures = 0;
+    GrayscaleImage a = random_image(40, 30, generator);
+    GrayscaleImage b = a;
+    GrayscaleImage c = a;
+    c.set_pixel(29, 39, c.get_pixel(29, 39) ^ 0x80);
+
+    for (int known = 0; known < 4; known++)
+    {
+        GrayscaleImage left = a, same = b, different = c;
+        if (known & 1)
+        {
+            left.content_hash();
+        }
+        if (known & 2)
+        {
+            same.content_hash();
+            different.content_hash();
+        }
+        if (!(left == same) || left == different)
+        {
+            std::cerr << "FAIL operator== with hashes known: " << ((known & 1) ? "left " : "")
+                      << ((known & 2) ? "right" : "") << std::endl;
+            failures++;
+        }
+    }
+
+    // A hash taken before a change must not decide the comparison: c's old
+    // hash differs from a's, but after the change their pixels are equal.
+    GrayscaleImage changed = c;
+    a.content_hash();
+    changed.content_hash();
+    changed.set_pixel(29, 39, a.get_pixel(29, 39));
+    if (!(changed == a))
+    {
+        std::cerr << "FAIL operator== after changing a pixel back" << std::endl;
+        failures++;
+    }
+
+    // Two moved-from images are both empty, whatever they held before.
+    GrayscaleImage first = random_image(8, 8, generator), second = random_image(9, 9, generator);
+    first.content_hash();
+    second.content_hash();
+    GrayscaleImage firstTaken(std::move(first)), secondTaken(std::move(second));
+    if (!(first == second))
+    {
+        std::cerr << "FAIL operator== on two moved-from images" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// Differences found pixel by pixel, in compare_tiles' order: tile rows top to
+// bottom, tiles left to right, only tiles with differences
+static std::vector<TileDifference> count_tiles(const ConstGrayscaleView &a, const ConstGrayscaleView &b,
+                                               int tileSize)
+{
+    std::vector<TileDifference> differences;
+    for (int top = 0; top < a.get_height(); top += tileSize)
+    {
+        for (int left = 0; left < a.get_width(); left += tileSize)
+        {
+            TileDifference tile = {top / tileSize, left / tileSize, 0, 0, 0, 0, 0};
+            for (int i = top; i < std::min(top + tileSize, a.get_height()); i++)
+            {
+                for (int j = left; j < std::min(left + tileSize, a.get_width()); j++)
+                {
+                    if (a.get_row(i)[j] == b.get_row(i)[j])
+                    {
+                        continue;
+                    }
+                    if (tile.pixels == 0)
+                    {
+                        tile.firstRow = tile.lastRow = i;
+                        tile.firstColumn = tile.lastColumn = j;
+                    }
+                    tile.lastRow = i;
+                    tile.firstColumn = std::min(tile.firstColumn, j);
+                    tile.lastColumn = std::max(tile.lastColumn, j);
+                    tile.pixels++;
+                }
+            }
+            if (tile.pixels > 0)
+            {
+                differences.push_back(tile);
+            }
+        }
+    }
+    return differences;
+}
+
+static bool same_tiles(const std::vector<TileDifference> &x, const std::vector<TileDifference> &y)
+{
+    if (x.size() != y.size())
+    {
+        return false;
+    }
+    for (size_t t = 0; t < x.size(); t++)
+    {
+        if (x[t].tileRow != y[t].tileRow || x[t].tileColumn != y[t].tileColumn || x[t].firstRow != y[t].firstRow ||
+            x[t].lastRow != y[t].lastRow || x[t].firstColumn != y[t].firstColumn ||
+            x[t].lastColumn != y[t].lastColumn || x[t].pixels != y[t].pixels)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int check_tiles(std::mt19937 &generator)
+{
+    const int tileSizes[] = {1, 7, 8, 16, 100};
+    std::uniform_int_distribution<int> row(0, 36), column(0, 49), clusterRow(20, 24), clusterColumn(30, 33);
+
+    GrayscaleImage a = random_image(50, 37, generator);
+    GrayscaleImage b = a;
+    // Scattered single pixels and one dense cluster
+    for (int k = 0; k < 25; k++)
+    {
+        int i = row(generator), j = column(generator);
+        b.set_pixel(i, j, b.get_pixel(i, j) ^ 0x10);
+    }
+    for (int k = 0; k < 12; k++)
+    {
+        int i = clusterRow(generator), j = clusterColumn(generator);
+        b.set_pixel(i, j, b.get_pixel(i, j) ^ 0x01);
+    }
+
+    int failures = 0;
+    for (int tileSize : tileSizes)
+    {
+        // The whole images, and views that start inside them
+        if (!same_tiles(GrayscaleImage::compare_tiles(a, b, tileSize), count_tiles(a, b, tileSize)))
+        {
+            std::cerr << "FAIL compare_tiles with " << tileSize << " pixel tiles" << std::endl;
+            failures++;
+        }
+        ConstGrayscaleView viewA = a.view(3, 5, 30, 41), viewB = b.view(3, 5, 30, 41);
+        if (!same_tiles(GrayscaleImage::compare_tiles(viewA, viewB, tileSize), count_tiles(viewA, viewB, tileSize)))
+        {
+            std::cerr << "FAIL compare_tiles on views with " << tileSize << " pixel tiles" << std::endl;
+            failures++;
+        }
+    }
+    if (!GrayscaleImage::compare_tiles(a, GrayscaleImage(a), 8).empty())
+    {
+        std::cerr << "FAIL compare_tiles reports differences between equal images" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(24);
+    int failures = check_vectors();
+    failures += check_image_hashes(generator);
+    failures += check_equality(generator);
+    failures += check_tiles(generator);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " hash or comparison check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "content hashes, operator== and compare_tiles are correct on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
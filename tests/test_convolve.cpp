@@ -0,0 +1,229 @@
+// Checks Filter::convolve against a brute-force 2D convolution on random
+// images, for rank-1 and rank-2 kernels that it splits into separable passes,
+// full-rank ones that it runs one tap row at a time, rectangular ones and
+// every border mode. The kernels all stay on the direct path; the FFT path
+// has its own test.
+//
+// Usage: test_convolve <sample_io directory>
+
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::vector<std::vector<double>> Kernel;
+
+struct KernelCase
+{
+    std::string name;
+    Kernel kernel;
+};
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+// A typical small image and one smaller than the largest kernels
+static const ImageSize SIZES[] = {{67, 45}, {6, 5}};
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+// Relative error the separable split and the row sums may leave, times the
+// sum of |weights| * 255; a rounded sum closer than that to .5 may go either way
+static const double ROUNDING_SLACK = 1e-9;
+
+// column * row, a rank-1 kernel
+static Kernel outer(const std::vector<double> &column, const std::vector<double> &row)
+{
+    Kernel kernel(column.size(), std::vector<double>(row.size()));
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        for (size_t j = 0; j < row.size(); j++)
+        {
+            kernel[i][j] = column[i] * row[j];
+        }
+    }
+    return kernel;
+}
+
+// Element-wise a + b
+static Kernel sum(const Kernel &a, const Kernel &b)
+{
+    Kernel kernel = a;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        for (size_t j = 0; j < a[i].size(); j++)
+        {
+            kernel[i][j] += b[i][j];
+        }
+    }
+    return kernel;
+}
+
+// rows x columns random weights in [-0.5, 1), normally of full rank, scaled to sum to 1
+static Kernel random_kernel(int rows, int columns, std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> weight(-0.5, 1.0);
+    Kernel kernel(rows, std::vector<double>(columns));
+    double total = 0.0;
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < columns; j++)
+        {
+            kernel[i][j] = weight(generator);
+            total += kernel[i][j];
+        }
+    }
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < columns; j++)
+        {
+            kernel[i][j] /= total;
+        }
+    }
+    return kernel;
+}
+
+static std::vector<KernelCase> kernel_cases(std::mt19937 &generator)
+{
+    std::vector<double> binomial5 = {1 / 16.0, 4 / 16.0, 6 / 16.0, 4 / 16.0, 1 / 16.0};
+    std::vector<double> box7(7, 1 / 7.0);
+    std::vector<double> ramp7 = {-3, -2, -1, 0, 1, 2, 3};
+    std::vector<double> hat7 = {0.05, 0.1, 0.15, 0.4, 0.15, 0.1, 0.05};
+
+    std::vector<KernelCase> cases;
+    cases.push_back({"identity 1x1", {{1.0}}});
+    cases.push_back({"sobel 3x3 (rank 1)", {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}}});
+    cases.push_back({"binomial 5x5 (rank 1)", outer(binomial5, binomial5)});
+    cases.push_back({"box x ramp 7x7 (rank 1)", outer(box7, ramp7)});
+    cases.push_back({"box + ramp 7x7 (rank 2)", sum(outer(box7, hat7), outer(ramp7, hat7))});
+    cases.push_back({"laplacian 3x3 (rank 2)", {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}}});
+    cases.push_back({"sharpen 3x3 (full rank)", {{0, -1, 0}, {-1, 5, -1}, {0, -1, 0}}});
+    cases.push_back({"random 5x5 (full rank)", random_kernel(5, 5, generator)});
+    cases.push_back({"random 9x9 (full rank)", random_kernel(9, 9, generator)});
+    cases.push_back({"random 15x15 (full rank)", random_kernel(15, 15, generator)});
+    cases.push_back({"binomial 1x5 (row)", outer({1.0}, binomial5)});
+    cases.push_back({"binomial 5x1 (column)", outer(binomial5, {1.0})});
+    cases.push_back({"binomial x box 5x7 (rank 1)", outer(binomial5, box7)});
+    cases.push_back({"random 3x7 (full rank)", random_kernel(3, 7, generator)});
+    cases.push_back({"random 9x3 (full rank)", random_kernel(9, 3, generator)});
+    return cases;
+}
+
+// Random pixels, the same on every run
+static GrayscaleImage random_image(int width, int height, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, static_cast<uint8_t>(pixel(generator)));
+        }
+    }
+    return image;
+}
+
+// Value of a weighted sum once rounded half up and clipped to 0 .. 255
+static int round_and_clip(double value)
+{
+    return static_cast<int>(std::min(std::max(value + 0.5, 0.0), 255.0));
+}
+
+// Compare convolve with the full 2D sum at every pixel, reading pixels outside
+// the image through Filter::border_index. Returns the number of pixels where
+// convolve's value is not the rounded sum, allowing either neighbour only when
+// the sum lies within rounding error of a .5 boundary.
+static long count_mismatches(const GrayscaleImage &original, const GrayscaleImage &convolved, const Kernel &kernel,
+                             BorderMode border)
+{
+    int height = original.get_height();
+    int width = original.get_width();
+    int kernelRows = static_cast<int>(kernel.size());
+    int kernelColumns = static_cast<int>(kernel[0].size());
+    double magnitude = 0.0;
+    for (const std::vector<double> &row : kernel)
+    {
+        for (double weight : row)
+        {
+            magnitude += std::fabs(weight);
+        }
+    }
+    double slack = ROUNDING_SLACK * magnitude * 255.0;
+
+    long mismatches = 0;
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            double total = 0.0;
+            for (int ki = 0; ki < kernelRows; ki++)
+            {
+                int r = Filter::border_index(i + ki - kernelRows / 2, height, border);
+                for (int kj = 0; kj < kernelColumns; kj++)
+                {
+                    int c = Filter::border_index(j + kj - kernelColumns / 2, width, border);
+                    if (r >= 0 && c >= 0)
+                    {
+                        total += kernel[ki][kj] * original.get_pixel(r, c);
+                    }
+                }
+            }
+            int actual = convolved.get_pixel(i, j);
+            if (actual != round_and_clip(total - slack) && actual != round_and_clip(total + slack))
+            {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(18);
+    std::vector<KernelCase> cases = kernel_cases(generator);
+    int failures = 0;
+    for (const ImageSize &size : SIZES)
+    {
+        GrayscaleImage original = random_image(size.width, size.height, generator);
+        for (const KernelCase &kernelCase : cases)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                GrayscaleImage convolved = original;
+                Filter::convolve(convolved, kernelCase.kernel, BORDERS[b]);
+                long mismatches = count_mismatches(original, convolved, kernelCase.kernel, BORDERS[b]);
+                if (mismatches > 0)
+                {
+                    std::cerr << "FAIL " << size.width << "x" << size.height << " " << kernelCase.name << " border "
+                              << BORDER_NAMES[b] << ": " << mismatches << " pixel(s) differ from the 2D sum"
+                              << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " case(s) differ from the brute-force convolution" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "convolve matches the brute-force 2D convolution on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
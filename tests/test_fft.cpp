@@ -0,0 +1,362 @@
+// Checks the FFT path of Filter::convolve: Fft against a naive DFT on every
+// radix and mixed lengths, the overlap-save convolution against a direct 2D
+// sum, and kernels on either side of the switch-over cost, including one
+// kernel that goes through both paths.
+//
+// Usage: test_fft <sample_io directory>
+
+#include "Fft.h"
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef std::complex<double> Complex;
+typedef std::vector<std::vector<double>> Kernel;
+
+// Pure radix 2, 4, 3 and 5 lengths, and mixed ones
+static const int FFT_LENGTHS[] = {1,  2,  3,  4,  5,   6,   8,   9,   12,  15,  16,  25,  27,  30,
+                                  32, 45, 60, 64, 75, 120, 125, 128, 135, 225, 243, 250, 360, 1024};
+
+// Largest error allowed against the naive DFT, relative to the sum of |input|
+static const double DFT_TOLERANCE = 1e-12;
+
+// Relative rounding error allowed in a convolution, times the sum of
+// |weights| * 255; a sum closer than that to .5 may round either way
+static const double ROUNDING_SLACK = 1e-9;
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+struct ConvolveCase
+{
+    std::string name;
+    int width, height;
+    Kernel kernel;
+};
+
+// out[k] = sum over j of in[j] * exp(-+2 pi i j k / n), straight from the definition
+static std::vector<Complex> naive_dft(const std::vector<Complex> &in, bool inverse)
+{
+    const double pi = std::acos(-1.0);
+    int n = static_cast<int>(in.size());
+    std::vector<Complex> out(n);
+    for (int k = 0; k < n; k++)
+    {
+        Complex total(0.0, 0.0);
+        for (int j = 0; j < n; j++)
+        {
+            // j * k reduced modulo n keeps the angle accurate for long lengths
+            double angle = 2.0 * pi * static_cast<double>(static_cast<long>(j) * k % n) / n;
+            total += in[j] * std::polar(1.0, inverse ? angle : -angle);
+        }
+        out[k] = total;
+    }
+    return out;
+}
+
+// Transform random samples of every length both ways, reading them with a
+// stride of 1 and 3, and compare with the naive DFT
+static int check_transforms(std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> sample(-1.0, 1.0);
+    int failures = 0;
+    for (int n : FFT_LENGTHS)
+    {
+        Fft fft(n);
+        for (int stride = 1; stride <= 3; stride += 2)
+        {
+            std::vector<Complex> in(n);
+            std::vector<Complex> strided(static_cast<size_t>(n) * stride);
+            double magnitude = 0.0;
+            for (int j = 0; j < n; j++)
+            {
+                in[j] = Complex(sample(generator), sample(generator));
+                strided[static_cast<size_t>(j) * stride] = in[j];
+                magnitude += std::abs(in[j]);
+            }
+            for (int inverse = 0; inverse < 2; inverse++)
+            {
+                std::vector<Complex> expected = naive_dft(in, inverse != 0);
+                std::vector<Complex> out(n);
+                fft.transform(strided.data(), stride, out.data(), inverse != 0);
+                double maxError = 0.0;
+                for (int k = 0; k < n; k++)
+                {
+                    maxError = std::max(maxError, std::abs(out[k] - expected[k]));
+                }
+                if (maxError > DFT_TOLERANCE * magnitude)
+                {
+                    std::cerr << "FAIL Fft length " << n << " stride " << stride << (inverse ? " inverse" : " forward")
+                              << ": error " << maxError << " against the naive DFT" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // Lengths with other prime factors are refused.
+    const int unsupported[] = {7, 14, 0};
+    for (int n : unsupported)
+    {
+        try
+        {
+            Fft fft(n);
+            std::cerr << "FAIL Fft length " << n << " was accepted" << std::endl;
+            failures++;
+        }
+        catch (const std::invalid_argument &)
+        {
+        }
+    }
+    return failures;
+}
+
+// column * row, a rank-1 kernel
+static Kernel outer(const std::vector<double> &column, const std::vector<double> &row)
+{
+    Kernel kernel(column.size(), std::vector<double>(row.size()));
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        for (size_t j = 0; j < row.size(); j++)
+        {
+            kernel[i][j] = column[i] * row[j];
+        }
+    }
+    return kernel;
+}
+
+// size random weights in [0.1, 1), scaled to sum to 1
+static std::vector<double> random_weights(int size, std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> weight(0.1, 1.0);
+    std::vector<double> weights(size);
+    double total = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        weights[i] = weight(generator);
+        total += weights[i];
+    }
+    for (int i = 0; i < size; i++)
+    {
+        weights[i] /= total;
+    }
+    return weights;
+}
+
+// size x size random weights in [-0.5, 1), normally of full rank, scaled to sum to 1
+static Kernel random_kernel(int size, std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> weight(-0.5, 1.0);
+    Kernel kernel(size, std::vector<double>(size));
+    double total = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            kernel[i][j] = weight(generator);
+            total += kernel[i][j];
+        }
+    }
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            kernel[i][j] /= total;
+        }
+    }
+    return kernel;
+}
+
+// The kernel in the middle of a square of zeros two taps wider
+static Kernel zero_framed(const Kernel &kernel)
+{
+    size_t size = kernel.size() + 2;
+    Kernel framed(size, std::vector<double>(size, 0.0));
+    for (size_t i = 0; i < kernel.size(); i++)
+    {
+        std::copy(kernel[i].begin(), kernel[i].end(), framed[i + 1].begin() + 1);
+    }
+    return framed;
+}
+
+// Filter::convolve's cost estimate puts a full-rank n x n kernel at n * n + 3 * n
+// and a rank-1 one at 4 * n, against a threshold of 280: full rank runs directly
+// up to 15x15 and rank 1 up to 69x69. A 15x15 kernel framed by zeros is still
+// full rank 15 to the direct path, but as a 17x17 kernel it costs 340 and goes
+// through the FFT: the same convolution on both paths.
+static std::vector<ConvolveCase> convolve_cases(std::mt19937 &generator)
+{
+    Kernel full15 = random_kernel(15, generator);
+    std::vector<double> column69 = random_weights(69, generator), row69 = random_weights(69, generator);
+    std::vector<double> column71 = random_weights(71, generator), row71 = random_weights(71, generator);
+
+    std::vector<ConvolveCase> cases;
+    cases.push_back({"full rank 15x15 (direct, cost 270)", 97, 61, full15});
+    cases.push_back({"full rank 15x15 framed to 17x17 (FFT, cost 340)", 97, 61, zero_framed(full15)});
+    cases.push_back({"rank 1 69x69 (direct, cost 276)", 97, 61, outer(column69, row69)});
+    cases.push_back({"rank 1 71x71 (FFT, cost 284)", 97, 61, outer(column71, row71)});
+    // One block of 75 x 45 samples: radix 3 and 5 lengths
+    cases.push_back({"full rank 17x17 on 59x29 (FFT)", 59, 29, random_kernel(17, generator)});
+    // Five blocks of 216 x 60 samples: the last pair has one block only
+    cases.push_back({"full rank 17x17 on 1000x40 (FFT)", 1000, 40, random_kernel(17, generator)});
+    // An image smaller than the kernel
+    cases.push_back({"full rank 21x21 on 9x7 (FFT)", 9, 7, random_kernel(21, generator)});
+    return cases;
+}
+
+// Random pixels that depend only on the size, so that cases of one size see
+// the same image
+static GrayscaleImage random_image(int width, int height)
+{
+    std::mt19937 generator(static_cast<unsigned>(width * 10007 + height));
+    std::uniform_int_distribution<int> pixel(0, 255);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, static_cast<uint8_t>(pixel(generator)));
+        }
+    }
+    return image;
+}
+
+// Value of a weighted sum once rounded half up and clipped to 0 .. 255
+static int round_and_clip(double value)
+{
+    return static_cast<int>(std::min(std::max(value + 0.5, 0.0), 255.0));
+}
+
+// Exact 2D sums of the kernel over the image, pixels outside it read through
+// Filter::border_index
+static std::vector<double> direct_sums(const GrayscaleImage &image, const Kernel &kernel, BorderMode border)
+{
+    int height = image.get_height();
+    int width = image.get_width();
+    int size = static_cast<int>(kernel.size());
+    int padSize = size / 2;
+    std::vector<int> columns(static_cast<size_t>(width) * size);
+    for (int j = 0; j < width; j++)
+    {
+        for (int kj = 0; kj < size; kj++)
+        {
+            columns[static_cast<size_t>(j) * size + kj] = Filter::border_index(j + kj - padSize, width, border);
+        }
+    }
+
+    std::vector<double> sums(static_cast<size_t>(width) * height, 0.0);
+    for (int i = 0; i < height; i++)
+    {
+        for (int ki = 0; ki < size; ki++)
+        {
+            int r = Filter::border_index(i + ki - padSize, height, border);
+            if (r < 0)
+            {
+                continue;
+            }
+            const uint8_t *pixels = image.get_row(r);
+            for (int j = 0; j < width; j++)
+            {
+                const int *tapColumns = &columns[static_cast<size_t>(j) * size];
+                double total = 0.0;
+                for (int kj = 0; kj < size; kj++)
+                {
+                    if (tapColumns[kj] >= 0)
+                    {
+                        total += kernel[ki][kj] * pixels[tapColumns[kj]];
+                    }
+                }
+                sums[static_cast<size_t>(i) * width + j] += total;
+            }
+        }
+    }
+    return sums;
+}
+
+// Pixels of convolved that are not the rounded direct sum, allowing either
+// neighbour only when the sum lies within rounding error of a .5 boundary
+static long count_mismatches(const GrayscaleImage &convolved, const std::vector<double> &sums, double slack)
+{
+    long mismatches = 0;
+    for (int i = 0; i < convolved.get_height(); i++)
+    {
+        for (int j = 0; j < convolved.get_width(); j++)
+        {
+            double total = sums[static_cast<size_t>(i) * convolved.get_width() + j];
+            int actual = convolved.get_pixel(i, j);
+            if (actual != round_and_clip(total - slack) && actual != round_and_clip(total + slack))
+            {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Convolve every case on one thread and on three, whose bands of block pairs
+// end unevenly, and compare with the direct sums
+static int check_convolutions(std::mt19937 &generator)
+{
+    const int threadCounts[] = {1, 3};
+    int failures = 0;
+    for (const ConvolveCase &convolveCase : convolve_cases(generator))
+    {
+        GrayscaleImage original = random_image(convolveCase.width, convolveCase.height);
+        double magnitude = 0.0;
+        for (const std::vector<double> &row : convolveCase.kernel)
+        {
+            for (double weight : row)
+            {
+                magnitude += std::fabs(weight);
+            }
+        }
+        for (int b = 0; b < 4; b++)
+        {
+            std::vector<double> sums = direct_sums(original, convolveCase.kernel, BORDERS[b]);
+            for (int threads : threadCounts)
+            {
+                ThreadPool::set_shared_thread_count(threads);
+                GrayscaleImage convolved = original;
+                Filter::convolve(convolved, convolveCase.kernel, BORDERS[b]);
+                long mismatches = count_mismatches(convolved, sums, ROUNDING_SLACK * magnitude * 255.0);
+                if (mismatches > 0)
+                {
+                    std::cerr << "FAIL " << convolveCase.name << " border " << BORDER_NAMES[b] << ", " << threads
+                              << " thread(s): " << mismatches << " pixel(s) differ from the direct sum" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    ThreadPool::set_shared_thread_count(0);
+    return failures;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(19);
+    int failures = check_transforms(generator);
+    failures += check_convolutions(generator);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " FFT check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Fft matches the naive DFT and the FFT path the direct convolution on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+// Checks that every filter gives byte-identical output whichever instruction set
+// the Simd kernels run on and however many threads the shared pool has: each one
+// is run at every level this CPU supports and on several thread counts, and
+// compared with the scalar kernels on a single thread.
+//
+// Usage: test_filter_determinism <sample_io directory>
+
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct FilterCase
+{
+    std::string name;
+    std::function<void(const GrayscaleView &)> apply;
+};
+
+static const char *IMAGES[] = {"gauss/puppy.png", "mean/creep.jpg"};
+
+// Thread counts compared with a single thread; the odd ones leave uneven
+// bands and tiles at the end of the image
+static const int THREAD_COUNTS[] = {2, 3, 8};
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+// size x size kernel of positive weights summing to 1 that is not separable,
+// so that convolve runs it directly (small sizes) or through the FFT (large ones)
+static std::vector<std::vector<double>> uneven_kernel(int size)
+{
+    std::vector<std::vector<double>> kernel(size, std::vector<double>(size));
+    double sum = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            kernel[i][j] = 1.0 + (i * 7 + j * 13) % 5;
+            sum += kernel[i][j];
+        }
+    }
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            kernel[i][j] /= sum;
+        }
+    }
+    return kernel;
+}
+
+static std::vector<FilterCase> filter_cases()
+{
+    std::vector<std::vector<double>> sobel = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+    std::vector<std::vector<double>> small = uneven_kernel(5);
+    std::vector<std::vector<double>> large = uneven_kernel(31);
+
+    std::vector<FilterCase> cases;
+    for (int b = 0; b < 4; b++)
+    {
+        BorderMode border = BORDERS[b];
+        std::string suffix = std::string(" border ") + BORDER_NAMES[b];
+        cases.push_back({"mean 3" + suffix, [=](const GrayscaleView &v) { Filter::apply_mean_filter(v, 3, border); }});
+        cases.push_back({"mean 19" + suffix, [=](const GrayscaleView &v) { Filter::apply_mean_filter(v, 19, border); }});
+        cases.push_back(
+            {"median 5" + suffix, [=](const GrayscaleView &v) { Filter::apply_median_filter(v, 5, border); }});
+        cases.push_back(
+            {"median 31" + suffix, [=](const GrayscaleView &v) { Filter::apply_median_filter(v, 31, border); }});
+        cases.push_back({"gauss 5 1.0" + suffix,
+                         [=](const GrayscaleView &v) { Filter::apply_gaussian_smoothing(v, 5, 1.0, border); }});
+        cases.push_back({"gauss 21 4.0" + suffix,
+                         [=](const GrayscaleView &v) { Filter::apply_gaussian_smoothing(v, 21, 4.0, border); }});
+        cases.push_back({"gauss 13 2.0" + suffix,
+                         [=](const GrayscaleView &v) { Filter::apply_gaussian_smoothing(v, 13, 2.0, border); }});
+        cases.push_back({"gauss fixed 9 2.0" + suffix, [=](const GrayscaleView &v) {
+                             Filter::apply_gaussian_smoothing(v, 9, 2.0, border, GAUSSIAN_FIXED);
+                         }});
+        cases.push_back({"gauss iir 2.0" + suffix, [=](const GrayscaleView &v) {
+                             Filter::apply_gaussian_smoothing(v, 0, 2.0, border, GAUSSIAN_IIR);
+                         }});
+        cases.push_back({"gauss iir 8.0" + suffix, [=](const GrayscaleView &v) {
+                             Filter::apply_gaussian_smoothing(v, 0, 8.0, border, GAUSSIAN_IIR);
+                         }});
+        cases.push_back({"unsharp 9 2.0" + suffix,
+                         [=](const GrayscaleView &v) { Filter::apply_unsharp_mask(v, 9, 2.0, border); }});
+        cases.push_back({"convolve sobel" + suffix, [=](const GrayscaleView &v) { Filter::convolve(v, sobel, border); }});
+        cases.push_back({"convolve 5x5" + suffix, [=](const GrayscaleView &v) { Filter::convolve(v, small, border); }});
+        cases.push_back({"convolve 31x31" + suffix, [=](const GrayscaleView &v) { Filter::convolve(v, large, border); }});
+    }
+    return cases;
+}
+
+// Output of one filter run on a copy of the image
+static GrayscaleImage run(const FilterCase &filter, const GrayscaleImage &original)
+{
+    GrayscaleImage result = original;
+    filter.apply(result);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string directory = argv[1];
+
+    // Levels above what this CPU supports cannot be run here.
+    Simd::Level widest = Simd::detect_level();
+    std::cout << "comparing instruction sets scalar to " << Simd::level_name(widest) << std::endl;
+
+    std::vector<FilterCase> cases = filter_cases();
+    int failures = 0;
+    for (const char *name : IMAGES)
+    {
+        std::string path = directory + "/" + name;
+        GrayscaleImage original(path.c_str());
+        for (const FilterCase &filter : cases)
+        {
+            Simd::set_level(Simd::SCALAR);
+            ThreadPool::set_shared_thread_count(1);
+            GrayscaleImage expected = run(filter, original);
+            for (int level = Simd::SCALAR + 1; level <= widest; level++)
+            {
+                Simd::set_level(static_cast<Simd::Level>(level));
+                if (!(run(filter, original) == expected))
+                {
+                    std::cerr << "FAIL " << name << " " << filter.name << ": "
+                              << Simd::level_name(Simd::active_level()) << " differs from scalar" << std::endl;
+                    failures++;
+                }
+            }
+
+            // The bands and tiles threads work on are independent of the
+            // instruction set, so thread counts are checked on the widest one.
+            for (int threads : THREAD_COUNTS)
+            {
+                ThreadPool::set_shared_thread_count(threads);
+                if (!(run(filter, original) == expected))
+                {
+                    std::cerr << "FAIL " << name << " " << filter.name << ": " << threads
+                              << " threads differ from 1 thread" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    Simd::set_level(widest);
+    ThreadPool::set_shared_thread_count(0);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " run(s) differ from the scalar kernels on 1 thread" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "every filter gives the same bytes on every instruction set and thread count" << std::endl;
+    return EXIT_SUCCESS;
+}
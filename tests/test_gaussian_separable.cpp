@@ -0,0 +1,128 @@
+// Checks that the separable Gaussian (two 1D passes) stays within one grey level
+// of the direct 2D convolution with generate_gaussian_kernel, the way the filter
+// was computed before it was split into passes.
+//
+// Usage: test_gaussian_separable <sample_io directory>
+
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Largest difference allowed between the two, in grey levels
+static const int TOLERANCE = 1;
+
+struct GaussianCase
+{
+    int kernelSize;
+    double sigma;
+};
+
+static const char *IMAGES[] = {"gauss/puppy.png", "unsharp/flowers.png"};
+
+static const GaussianCase CASES[] = {{3, 1.0}, {5, 1.0}, {9, 2.0}, {21, 2.0}, {21, 4.0}, {41, 4.0}};
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+// Direct 2D convolution: every output pixel is the full kernelSize^2 weighted
+// sum, truncated towards zero
+static GrayscaleImage brute_force_gaussian(const GrayscaleImage &image, int kernelSize, double sigma,
+                                           BorderMode border)
+{
+    std::vector<std::vector<double>> kernel = Filter::generate_gaussian_kernel(kernelSize, sigma);
+    int height = image.get_height();
+    int width = image.get_width();
+    int padSize = kernelSize / 2;
+    GrayscaleImage result(width, height);
+
+    // Source column of every tap, -1 where it reads as zero
+    std::vector<int> columns(static_cast<size_t>(width) * kernelSize);
+    for (int j = 0; j < width; j++)
+    {
+        for (int col = 0; col < kernelSize; col++)
+        {
+            columns[j * kernelSize + col] = Filter::border_index(j + col - padSize, width, border);
+        }
+    }
+
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            const int *tapColumns = &columns[j * kernelSize];
+            double sum = 0.0;
+            for (int row = 0; row < kernelSize; row++)
+            {
+                int r = Filter::border_index(i + row - padSize, height, border);
+                if (r < 0)
+                {
+                    continue;
+                }
+                const uint8_t *pixels = image.get_row(r);
+                for (int col = 0; col < kernelSize; col++)
+                {
+                    if (tapColumns[col] >= 0)
+                    {
+                        sum += pixels[tapColumns[col]] * kernel[row][col];
+                    }
+                }
+            }
+            int value = static_cast<int>(sum);
+            result.set_pixel(i, j, static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value)));
+        }
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string directory = argv[1];
+
+    int failures = 0;
+    for (const char *name : IMAGES)
+    {
+        std::string path = directory + "/" + name;
+        GrayscaleImage original(path.c_str());
+        for (const GaussianCase &gaussian : CASES)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                GrayscaleImage expected = brute_force_gaussian(original, gaussian.kernelSize, gaussian.sigma, BORDERS[b]);
+                GrayscaleImage separable = original;
+                Filter::apply_gaussian_smoothing(separable, gaussian.kernelSize, gaussian.sigma, BORDERS[b]);
+
+                int maxDiff = 0;
+                for (int i = 0; i < original.get_height(); i++)
+                {
+                    for (int j = 0; j < original.get_width(); j++)
+                    {
+                        int diff = std::abs(separable.get_pixel(i, j) - expected.get_pixel(i, j));
+                        maxDiff = diff > maxDiff ? diff : maxDiff;
+                    }
+                }
+                if (maxDiff > TOLERANCE)
+                {
+                    std::cerr << "FAIL " << name << " kernel " << gaussian.kernelSize << " sigma " << gaussian.sigma
+                              << " border " << BORDER_NAMES[b] << ": max |diff| " << maxDiff << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " case(s) differ by more than " << TOLERANCE << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "separable Gaussian within " << TOLERANCE << " of the 2D kernel on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+// Checks the running-sum mean filter against a brute-force mean: the integer
+// sum over every window divided by kernelSize squared, as the original nested
+// loops computed it. Kernel sizes 3 to 11 (the unrolled box sums, reached by
+// even sizes too, whose window is the next odd size) and the generic sizes 13
+// and 19 run with every border mode, on every instruction set, and with the
+// tiles forced down to their narrowest on three threads.
+//
+// Usage: test_mean_filter <sample_io directory>
+
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "TileLayout.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+// Wider than the narrowest tile, a small one, and one smaller than most of
+// the kernels
+static const ImageSize SIZES[] = {{300, 40}, {23, 17}, {5, 4}};
+
+static const int KERNELS[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 19};
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+struct TileSetting
+{
+    const char *name;
+    int cacheBytes; // for TileLayout::set_cache_sizes, 0 = detected
+    int threads;
+};
+
+static const TileSetting TILE_SETTINGS[] = {{"default tiles", 0, 1}, {"narrowest tiles, 3 threads", 1, 3}};
+
+// Random pixels, the same on every run: uniform over 0 .. 255, or bright
+// (192 .. 255) so that the sums of even kernels, whose window holds more than
+// kernelSize squared pixels, pass 255 * kernelSize squared
+static GrayscaleImage random_image(int width, int height, bool bright, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(bright ? 192 : 0, 255);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, static_cast<uint8_t>(pixel(generator)));
+        }
+    }
+    return image;
+}
+
+// Sum of every window divided by kernelSize squared, kept to 8 bits as the
+// original filter saved it; pixels outside the image read through
+// Filter::border_index, as 0 where it returns -1
+static GrayscaleImage brute_force_mean(const GrayscaleImage &image, int kernelSize, BorderMode border)
+{
+    int height = image.get_height();
+    int width = image.get_width();
+    int padSize = kernelSize / 2;
+    GrayscaleImage result(width, height);
+
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int sum = 0;
+            for (int row = i - padSize; row <= i + padSize; row++)
+            {
+                int r = Filter::border_index(row, height, border);
+                for (int col = j - padSize; col <= j + padSize; col++)
+                {
+                    int c = Filter::border_index(col, width, border);
+                    sum += (r < 0 || c < 0) ? 0 : image.get_pixel(r, c);
+                }
+            }
+            result.set_pixel(i, j, static_cast<uint8_t>(sum / (kernelSize * kernelSize)));
+        }
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Simd::Level widest = Simd::detect_level();
+    std::mt19937 generator(6);
+    int failures = 0;
+    for (const ImageSize &size : SIZES)
+    {
+        for (int bright = 0; bright < 2; bright++)
+        {
+            GrayscaleImage original = random_image(size.width, size.height, bright != 0, generator);
+            for (int kernelSize : KERNELS)
+            {
+                for (int b = 0; b < 4; b++)
+                {
+                    GrayscaleImage expected = brute_force_mean(original, kernelSize, BORDERS[b]);
+                    for (int level = Simd::SCALAR; level <= widest; level++)
+                    {
+                        Simd::set_level(static_cast<Simd::Level>(level));
+                        for (const TileSetting &setting : TILE_SETTINGS)
+                        {
+                            TileLayout::set_cache_sizes(setting.cacheBytes, setting.cacheBytes);
+                            ThreadPool::set_shared_thread_count(setting.threads);
+                            GrayscaleImage filtered = original;
+                            Filter::apply_mean_filter(filtered, kernelSize, BORDERS[b]);
+                            if (!(filtered == expected))
+                            {
+                                std::cerr << "FAIL " << size.width << "x" << size.height
+                                          << (bright ? " bright" : " uniform") << " kernel " << kernelSize
+                                          << " border " << BORDER_NAMES[b] << " "
+                                          << Simd::level_name(Simd::active_level()) << " " << setting.name
+                                          << ": differs from the brute-force mean" << std::endl;
+                                failures++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    Simd::set_level(widest);
+    TileLayout::set_cache_sizes(0, 0);
+    ThreadPool::set_shared_thread_count(0);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " case(s) differ from the brute-force mean" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "mean filter matches the brute-force mean on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
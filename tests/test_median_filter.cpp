@@ -0,0 +1,147 @@
+// Checks the constant-time median filter against a brute-force median, found
+// with std::nth_element over every window, on random images for small and
+// large kernels and every border mode. Each case also runs with the tiles
+// forced down to their narrowest and three threads, so that windows straddle
+// tile edges and bands.
+//
+// Usage: test_median_filter <sample_io directory>
+
+#include "Filter.h"
+#include "GrayscaleImage.h"
+#include "ThreadPool.h"
+#include "TileLayout.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+// Wider than the narrowest tile and tall enough for several bands with small
+// kernels, a small one, and one smaller than most of the kernels
+static const ImageSize SIZES[] = {{300, 48}, {45, 30}, {7, 5}};
+
+// Even sizes use the next odd window, like the filter
+static const int KERNELS[] = {1, 2, 3, 4, 5, 7, 9, 11, 13, 31, 61};
+
+static const BorderMode BORDERS[] = {BORDER_ZERO, BORDER_REPLICATE, BORDER_REFLECT, BORDER_WRAP};
+static const char *BORDER_NAMES[] = {"zero", "replicate", "reflect", "wrap"};
+
+// Values either side of the 16-value runs the coarse histogram counts
+static const uint8_t CLUSTERED_VALUES[] = {0, 15, 16, 17, 31, 32, 128, 239, 240, 255};
+
+struct TileSetting
+{
+    const char *name;
+    int cacheBytes; // for TileLayout::set_cache_sizes, 0 = detected
+    int threads;
+};
+
+static const TileSetting TILE_SETTINGS[] = {{"default tiles", 0, 1}, {"narrowest tiles, 3 threads", 1, 3}};
+
+// Random pixels, the same on every run: uniform over 0 .. 255, or drawn from
+// CLUSTERED_VALUES so that many windows hold ties around a coarse bin edge
+static GrayscaleImage random_image(int width, int height, bool clustered, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255);
+    std::uniform_int_distribution<int> pick(0, sizeof(CLUSTERED_VALUES) - 1);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int value = clustered ? CLUSTERED_VALUES[pick(generator)] : pixel(generator);
+            image.set_pixel(i, j, static_cast<uint8_t>(value));
+        }
+    }
+    return image;
+}
+
+// Median of every window, found by partial sorting; pixels outside the image
+// read through Filter::border_index, as 0 where it returns -1
+static GrayscaleImage brute_force_median(const GrayscaleImage &image, int kernelSize, BorderMode border)
+{
+    int height = image.get_height();
+    int width = image.get_width();
+    int padSize = kernelSize / 2;
+    int windowSize = 2 * padSize + 1;
+    GrayscaleImage result(width, height);
+    std::vector<uint8_t> window(static_cast<size_t>(windowSize) * windowSize);
+
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            size_t n = 0;
+            for (int row = i - padSize; row <= i + padSize; row++)
+            {
+                int r = Filter::border_index(row, height, border);
+                for (int col = j - padSize; col <= j + padSize; col++)
+                {
+                    int c = Filter::border_index(col, width, border);
+                    window[n++] = (r < 0 || c < 0) ? 0 : image.get_pixel(r, c);
+                }
+            }
+            std::nth_element(window.begin(), window.begin() + n / 2, window.end());
+            result.set_pixel(i, j, window[n / 2]);
+        }
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(20);
+    int failures = 0;
+    for (const ImageSize &size : SIZES)
+    {
+        for (int clustered = 0; clustered < 2; clustered++)
+        {
+            GrayscaleImage original = random_image(size.width, size.height, clustered != 0, generator);
+            for (int kernelSize : KERNELS)
+            {
+                for (int b = 0; b < 4; b++)
+                {
+                    GrayscaleImage expected = brute_force_median(original, kernelSize, BORDERS[b]);
+                    for (const TileSetting &setting : TILE_SETTINGS)
+                    {
+                        TileLayout::set_cache_sizes(setting.cacheBytes, setting.cacheBytes);
+                        ThreadPool::set_shared_thread_count(setting.threads);
+                        GrayscaleImage filtered = original;
+                        Filter::apply_median_filter(filtered, kernelSize, BORDERS[b]);
+                        if (!(filtered == expected))
+                        {
+                            std::cerr << "FAIL " << size.width << "x" << size.height
+                                      << (clustered ? " clustered" : " uniform") << " kernel " << kernelSize
+                                      << " border " << BORDER_NAMES[b] << " " << setting.name
+                                      << ": differs from the brute-force median" << std::endl;
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    TileLayout::set_cache_sizes(0, 0);
+    ThreadPool::set_shared_thread_count(0);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " case(s) differ from the brute-force median" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "median filter matches the brute-force median on every case" << std::endl;
+    return EXIT_SUCCESS;
+}
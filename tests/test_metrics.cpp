@@ -0,0 +1,264 @@
+// Checks MAE, MSE, PSNR and SSIM (Gaussian and box windows) against direct
+// per-pixel and per-window computations, on random image pairs from 1x1 up to
+// several SSIM bands tall, including sizes below the 11x11 window. Every
+// result must also be the same, bit for bit, on each instruction set and on
+// one and three threads.
+//
+// Usage: test_metrics <sample_io directory>
+
+#include "GrayscaleImage.h"
+#include "Metrics.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+// Sizes below, at and above the 11x11 SSIM window, and one tall enough for
+// several 32-row SSIM bands
+static const ImageSize SIZES[] = {{1, 1}, {2, 3}, {4, 9}, {7, 5}, {10, 10}, {11, 11}, {12, 13}, {45, 83}};
+
+// How the second image of a pair is made from the first
+enum PairKind
+{
+    PAIR_IDENTICAL, // the same pixels: MSE 0, infinite PSNR, SSIM 1
+    PAIR_NOISY,     // small clamped noise added
+    PAIR_UNRELATED, // independent random pixels
+    PAIR_FLAT       // two constant images: zero variance everywhere
+};
+
+static const PairKind PAIRS[] = {PAIR_IDENTICAL, PAIR_NOISY, PAIR_UNRELATED, PAIR_FLAT};
+static const char *PAIR_NAMES[] = {"identical", "noisy", "unrelated", "flat"};
+
+static const int THREAD_COUNTS[] = {1, 3};
+
+// Largest difference allowed between SSIM and the direct per-window value,
+// which sums in a different order
+static const double SSIM_TOLERANCE = 1e-9;
+
+// Standard deviation of the Gaussian window and the stabilising constants,
+// as given by Wang et al. (2004)
+static const double SIGMA = 1.5;
+static const double C1 = (0.01 * 255) * (0.01 * 255);
+static const double C2 = (0.03 * 255) * (0.03 * 255);
+
+struct Expected
+{
+    double mae, mse, psnr, ssimGaussian, ssimBox;
+};
+
+static void make_pair(PairKind kind, int width, int height, std::mt19937 &generator, GrayscaleImage &a,
+                      GrayscaleImage &b)
+{
+    std::uniform_int_distribution<int> pixel(0, 255), noise(-6, 6);
+    int flatA = pixel(generator), flatB = pixel(generator);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int x = kind == PAIR_FLAT ? flatA : pixel(generator);
+            int y = x;
+            if (kind == PAIR_NOISY)
+            {
+                y = std::min(255, std::max(0, x + noise(generator)));
+            }
+            else if (kind == PAIR_UNRELATED)
+            {
+                y = pixel(generator);
+            }
+            else if (kind == PAIR_FLAT)
+            {
+                y = flatB;
+            }
+            a.set_pixel(i, j, static_cast<uint8_t>(x));
+            b.set_pixel(i, j, static_cast<uint8_t>(y));
+        }
+    }
+}
+
+// Mean SSIM over every position of a size x size window inside the image,
+// each window's statistics summed directly with the given 2D weights
+static double direct_ssim(const GrayscaleImage &a, const GrayscaleImage &b, int size,
+                          const std::vector<double> &weights)
+{
+    double total = 0.0;
+    int positions = 0;
+    for (int top = 0; top + size <= a.get_height(); top++)
+    {
+        for (int left = 0; left + size <= a.get_width(); left++)
+        {
+            double meanA = 0.0, meanB = 0.0;
+            for (int i = 0; i < size; i++)
+            {
+                for (int j = 0; j < size; j++)
+                {
+                    double w = weights[i * size + j];
+                    meanA += w * a.get_pixel(top + i, left + j);
+                    meanB += w * b.get_pixel(top + i, left + j);
+                }
+            }
+            double varianceA = 0.0, varianceB = 0.0, covariance = 0.0;
+            for (int i = 0; i < size; i++)
+            {
+                for (int j = 0; j < size; j++)
+                {
+                    double w = weights[i * size + j];
+                    double x = a.get_pixel(top + i, left + j) - meanA;
+                    double y = b.get_pixel(top + i, left + j) - meanB;
+                    varianceA += w * x * x;
+                    varianceB += w * y * y;
+                    covariance += w * x * y;
+                }
+            }
+            total += ((2 * meanA * meanB + C1) * (2 * covariance + C2)) /
+                     ((meanA * meanA + meanB * meanB + C1) * (varianceA + varianceB + C2));
+            positions++;
+        }
+    }
+    return total / positions;
+}
+
+static Expected direct_metrics(const GrayscaleImage &a, const GrayscaleImage &b)
+{
+    long absolute = 0, squared = 0;
+    for (int i = 0; i < a.get_height(); i++)
+    {
+        for (int j = 0; j < a.get_width(); j++)
+        {
+            long d = static_cast<long>(a.get_pixel(i, j)) - b.get_pixel(i, j);
+            absolute += std::labs(d);
+            squared += d * d;
+        }
+    }
+    double pixels = static_cast<double>(a.get_width()) * a.get_height();
+
+    Expected expected;
+    expected.mae = absolute / pixels;
+    expected.mse = squared / pixels;
+    expected.psnr =
+        squared == 0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / expected.mse);
+
+    // The largest odd window up to 11 that fits
+    int size = std::min(11, std::min(a.get_width(), a.get_height()));
+    if (size % 2 == 0)
+    {
+        size--;
+    }
+    std::vector<double> gaussian(size), gaussian2d(size * size), box(size * size, 1.0 / (size * size));
+    double sum = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        double x = i - size / 2;
+        gaussian[i] = std::exp(-x * x / (2 * SIGMA * SIGMA));
+        sum += gaussian[i];
+    }
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            gaussian2d[i * size + j] = gaussian[i] / sum * gaussian[j] / sum;
+        }
+    }
+    expected.ssimGaussian = direct_ssim(a, b, size, gaussian2d);
+    expected.ssimBox = direct_ssim(a, b, size, box);
+    return expected;
+}
+
+// Check every metric against the direct values; MAE, MSE and PSNR come from
+// exact integer sums, so only SSIM is allowed rounding differences
+static bool matches(const ImageComparison &comparison, double ssimBox, const Expected &expected, bool identical)
+{
+    bool ok = comparison.meanAbsoluteError == expected.mae && comparison.meanSquaredError == expected.mse &&
+              comparison.psnr == expected.psnr &&
+              std::fabs(comparison.ssim - expected.ssimGaussian) <= SSIM_TOLERANCE &&
+              std::fabs(ssimBox - expected.ssimBox) <= SSIM_TOLERANCE;
+    if (identical)
+    {
+        ok = ok && comparison.meanAbsoluteError == 0.0 && comparison.meanSquaredError == 0.0 &&
+             std::isinf(comparison.psnr) && comparison.psnr > 0 && comparison.ssim == 1.0 && ssimBox == 1.0;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Simd::Level widest = Simd::detect_level();
+    std::mt19937 generator(25);
+    int failures = 0;
+    for (const ImageSize &size : SIZES)
+    {
+        for (int p = 0; p < 4; p++)
+        {
+            GrayscaleImage a(size.width, size.height), b(size.width, size.height);
+            make_pair(PAIRS[p], size.width, size.height, generator, a, b);
+            Expected expected = direct_metrics(a, b);
+            std::string name = std::to_string(size.width) + "x" + std::to_string(size.height) + " " + PAIR_NAMES[p];
+
+            // The scalar kernels on one thread give the reference every other
+            // run must repeat exactly.
+            Simd::set_level(Simd::SCALAR);
+            ThreadPool::set_shared_thread_count(1);
+            ImageComparison reference = Metrics::compare(a, b, SSIM_GAUSSIAN);
+            double referenceBox = Metrics::ssim(a, b, SSIM_BOX);
+            if (!matches(reference, referenceBox, expected, PAIRS[p] == PAIR_IDENTICAL) ||
+                Metrics::mean_absolute_error(a, b) != expected.mae ||
+                Metrics::mean_squared_error(a, b) != expected.mse || Metrics::psnr(a, b) != expected.psnr ||
+                Metrics::ssim(a, b) != reference.ssim)
+            {
+                std::cerr << "FAIL " << name << ": MAE " << reference.meanAbsoluteError << " (" << expected.mae
+                          << "), MSE " << reference.meanSquaredError << " (" << expected.mse << "), PSNR "
+                          << reference.psnr << " (" << expected.psnr << "), SSIM " << reference.ssim << " ("
+                          << expected.ssimGaussian << "), box SSIM " << referenceBox << " (" << expected.ssimBox
+                          << ")" << std::endl;
+                failures++;
+            }
+
+            for (int level = Simd::SCALAR; level <= widest; level++)
+            {
+                Simd::set_level(static_cast<Simd::Level>(level));
+                for (int threads : THREAD_COUNTS)
+                {
+                    ThreadPool::set_shared_thread_count(threads);
+                    ImageComparison comparison = Metrics::compare(a, b, SSIM_BOX);
+                    double gaussian = Metrics::ssim(a, b, SSIM_GAUSSIAN);
+                    if (comparison.meanAbsoluteError != reference.meanAbsoluteError ||
+                        comparison.meanSquaredError != reference.meanSquaredError ||
+                        comparison.psnr != reference.psnr || comparison.ssim != referenceBox ||
+                        gaussian != reference.ssim)
+                    {
+                        std::cerr << "FAIL " << name << ": " << Simd::level_name(Simd::active_level()) << " on "
+                                  << threads << " thread(s) differs from scalar on 1 thread" << std::endl;
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    Simd::set_level(widest);
+    ThreadPool::set_shared_thread_count(0);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " metric check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "every metric matches the direct computation on every instruction set and thread count"
+              << std::endl;
+    return EXIT_SUCCESS;
+}
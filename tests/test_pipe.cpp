@@ -0,0 +1,176 @@
+// Checks that clearvision pipe writes byte-identical output to the same chain
+// of single commands, each reading the previous one's PNG. Runs the program,
+// so it has to be built first; the images are copied into the working
+// directory, where all outputs go, and removed afterwards.
+//
+// Usage: test_pipe <sample_io directory> [<clearvision program>]
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct PipeStage
+{
+    std::string operation;
+    std::vector<std::string> args;
+};
+
+struct PipeCase
+{
+    std::string options;
+    std::vector<PipeStage> stages;
+};
+
+// Two images of the same size, copied to these names
+static const char *INPUT = "pipe_input.png";
+static const char *OPERAND = "pipe_operand.png";
+
+// Chains covering every stage, the global options, and runs of add / sub
+// stages, which the pipe fuses into one pass
+static const PipeCase CASES[] = {
+    {"", {{"mean", {"5"}}, {"unsharp", {"9", "2.0"}}, {"sub", {INPUT}}}},
+    {"--border reflect", {{"median", {"7"}}, {"gauss", {"9", "2.0"}}, {"add", {OPERAND}}}},
+    {"--threads 3", {{"add", {OPERAND}}, {"sub", {OPERAND}}, {"add", {INPUT}}, {"gauss", {"5", "1.0"}}}},
+    {"--gaussian fixed --border wrap", {{"gauss", {"9", "2.0"}}, {"sub", {OPERAND}}, {"unsharp", {"5", "1.5"}}}},
+    {"--gaussian iir --threads 3", {{"gauss", {"5", "3.0"}}, {"median", {"3"}}, {"add", {OPERAND}}}},
+};
+
+static bool read_file(const std::string &filename, std::string &contents)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+static bool copy_file(const std::string &from, const std::string &to)
+{
+    std::string contents;
+    if (!read_file(from, contents))
+    {
+        return false;
+    }
+    std::ofstream file(to.c_str(), std::ios::binary);
+    file << contents;
+    return static_cast<bool>(file);
+}
+
+// Filename without its extension, as clearvision names its outputs
+static std::string stem(const std::string &filename)
+{
+    return filename.substr(0, filename.find_last_of('.'));
+}
+
+// File the single command for a stage writes when given input
+static std::string single_output(const std::string &input, const PipeStage &stage)
+{
+    const std::vector<std::string> &args = stage.args;
+    if (stage.operation == "mean")
+    {
+        return "mean_filtered_" + stem(input) + "_" + args[0] + ".png";
+    }
+    if (stage.operation == "median")
+    {
+        return "median_filtered_" + stem(input) + "_" + args[0] + ".png";
+    }
+    if (stage.operation == "gauss")
+    {
+        return "gaussian_filtered_" + stem(input) + "_" + args[0] + "_" +
+               std::to_string(static_cast<double>(std::stof(args[1]))) + ".png";
+    }
+    if (stage.operation == "unsharp")
+    {
+        return "unsharp_filtered_" + stem(input) + "_" + args[0] + "_" +
+               std::to_string(static_cast<double>(std::stof(args[1]))) + ".png";
+    }
+    return (stage.operation == "add" ? "added_" : "subtracted_") + stem(input) + "_" + stem(args[0]) + ".png";
+}
+
+// Runs the program with the given arguments; true if it exits with 0
+static bool run(const std::string &program, const std::string &arguments)
+{
+    std::string command = "\"" + program + "\" " + arguments;
+    if (std::system(command.c_str()) != 0)
+    {
+        std::cerr << "FAIL command failed: " << command << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory> [<clearvision program>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string directory = argv[1];
+    std::string program = argc == 3 ? argv[2] : "./clearvision";
+
+    if (!copy_file(directory + "/addition/image1.png", INPUT) ||
+        !copy_file(directory + "/addition/image2.png", OPERAND))
+    {
+        std::cerr << "FAIL cannot copy the images from " << directory << "/addition" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> created = {INPUT, OPERAND};
+
+    int failures = 0;
+    int number = 0;
+    for (const PipeCase &pipeCase : CASES)
+    {
+        // The chain as single commands, each reading the previous output
+        std::string current = INPUT;
+        std::string stages;
+        bool ran = true;
+        for (const PipeStage &stage : pipeCase.stages)
+        {
+            std::string arguments = pipeCase.options + " " + stage.operation + " " + current;
+            stages += " " + stage.operation;
+            for (const std::string &arg : stage.args)
+            {
+                arguments += " " + arg;
+                stages += " " + arg;
+            }
+            ran = ran && run(program, arguments);
+            current = single_output(current, stage);
+            created.push_back(current);
+        }
+
+        // The same chain as one pipe
+        std::string piped = "pipe_output_" + std::to_string(++number) + ".png";
+        created.push_back(piped);
+        ran = run(program, pipeCase.options + " pipe " + INPUT + stages + " " + piped) && ran;
+
+        std::string expected, actual;
+        if (!ran || !read_file(current, expected) || !read_file(piped, actual) || expected != actual)
+        {
+            std::cerr << "FAIL pipe" << stages << " (options: '" << pipeCase.options
+                      << "') does not match the single commands" << std::endl;
+            failures++;
+        }
+    }
+
+    for (const std::string &filename : created)
+    {
+        std::remove(filename.c_str());
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " pipe(s) differ from the single commands" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "every pipe matches the same chain of single commands" << std::endl;
+    return EXIT_SUCCESS;
+}
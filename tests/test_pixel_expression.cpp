@@ -0,0 +1,201 @@
+// Checks pixel expressions whose result is also one of their operands: the
+// leftmost operand (evaluated in place), operands further right (which must
+// not be overwritten before they are read), nested right-hand subexpressions
+// (evaluated into scratch rows), and views of the result shifted by a row or
+// a column. Each case is compared with a per-pixel reference computed from
+// copies of the operands taken beforehand.
+//
+// Usage: test_pixel_expression <sample_io directory>
+
+#include "GrayscaleImage.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const int WIDTH = 37;
+static const int HEIGHT = 23;
+
+// The image being assigned to (g) and three other operands
+struct Operands
+{
+    GrayscaleImage g, b, c, d;
+};
+
+struct ExpressionCase
+{
+    const char *name;
+    std::function<void(Operands &)> apply;
+    // Value of g at (i, j) afterwards, from the operands beforehand
+    std::function<int(const Operands &, int, int)> expected;
+};
+
+static int add(int x, int y)
+{
+    return std::min(255, x + y);
+}
+
+static int sub(int x, int y)
+{
+    return std::max(0, x - y);
+}
+
+static const std::vector<ExpressionCase> &expression_cases()
+{
+    typedef const Operands &S;
+    static const std::vector<ExpressionCase> cases = {
+        // The leftmost operand is the result: evaluated in place
+        {"g = g + b", [](Operands &o) { o.g = o.g + o.b; },
+         [](S s, int i, int j) { return add(s.g.get_pixel(i, j), s.b.get_pixel(i, j)); }},
+        {"g = g - b + c", [](Operands &o) { o.g = o.g - o.b + o.c; },
+         [](S s, int i, int j) { return add(sub(s.g.get_pixel(i, j), s.b.get_pixel(i, j)), s.c.get_pixel(i, j)); }},
+        {"g = g + g", [](Operands &o) { o.g = o.g + o.g; },
+         [](S s, int i, int j) { return add(s.g.get_pixel(i, j), s.g.get_pixel(i, j)); }},
+
+        // The result appears further right
+        {"g = b - g", [](Operands &o) { o.g = o.b - o.g; },
+         [](S s, int i, int j) { return sub(s.b.get_pixel(i, j), s.g.get_pixel(i, j)); }},
+        {"g = b + c - g", [](Operands &o) { o.g = o.b + o.c - o.g; },
+         [](S s, int i, int j) { return sub(add(s.b.get_pixel(i, j), s.c.get_pixel(i, j)), s.g.get_pixel(i, j)); }},
+        {"g = g - b - g", [](Operands &o) { o.g = o.g - o.b - o.g; },
+         [](S s, int i, int j) { return sub(sub(s.g.get_pixel(i, j), s.b.get_pixel(i, j)), s.g.get_pixel(i, j)); }},
+
+        // Nested right-hand subexpressions, each needing a scratch row
+        {"g = g - (b + c)", [](Operands &o) { o.g = o.g - (o.b + o.c); },
+         [](S s, int i, int j) { return sub(s.g.get_pixel(i, j), add(s.b.get_pixel(i, j), s.c.get_pixel(i, j))); }},
+        {"g = b - (c - (d + g))", [](Operands &o) { o.g = o.b - (o.c - (o.d + o.g)); },
+         [](S s, int i, int j) {
+             return sub(s.b.get_pixel(i, j), sub(s.c.get_pixel(i, j), add(s.d.get_pixel(i, j), s.g.get_pixel(i, j))));
+         }},
+        {"g = (g + b) - (c - d)", [](Operands &o) { o.g = (o.g + o.b) - (o.c - o.d); },
+         [](S s, int i, int j) {
+             return sub(add(s.g.get_pixel(i, j), s.b.get_pixel(i, j)), sub(s.c.get_pixel(i, j), s.d.get_pixel(i, j)));
+         }},
+        {"g = (b - (c + d)) + (g - (d - b))", [](Operands &o) { o.g = (o.b - (o.c + o.d)) + (o.g - (o.d - o.b)); },
+         [](S s, int i, int j) {
+             return add(sub(s.b.get_pixel(i, j), add(s.c.get_pixel(i, j), s.d.get_pixel(i, j))),
+                        sub(s.g.get_pixel(i, j), sub(s.d.get_pixel(i, j), s.b.get_pixel(i, j))));
+         }},
+
+        // Compound assignment
+        {"g += b - c", [](Operands &o) { o.g += o.b - o.c; },
+         [](S s, int i, int j) { return add(s.g.get_pixel(i, j), sub(s.b.get_pixel(i, j), s.c.get_pixel(i, j))); }},
+        {"g -= g - b", [](Operands &o) { o.g -= o.g - o.b; },
+         [](S s, int i, int j) { return sub(s.g.get_pixel(i, j), sub(s.g.get_pixel(i, j), s.b.get_pixel(i, j))); }},
+        {"g += b + (c - g)", [](Operands &o) { o.g += o.b + (o.c - o.g); },
+         [](S s, int i, int j) {
+             return add(s.g.get_pixel(i, j), add(s.b.get_pixel(i, j), sub(s.c.get_pixel(i, j), s.g.get_pixel(i, j))));
+         }},
+
+        // Views of g shifted against the result: row-by-row evaluation in place
+        // would read pixels it has already written
+        {"g[:, 1:] = g[:, :-1] + b[:, :-1]",
+         [](Operands &o) {
+             (o.g.view(0, 0, HEIGHT, WIDTH - 1) + o.b.view(0, 0, HEIGHT, WIDTH - 1))
+                 .evaluate_into(o.g.view(0, 1, HEIGHT, WIDTH - 1));
+         },
+         [](S s, int i, int j) {
+             return j == 0 ? s.g.get_pixel(i, j) : add(s.g.get_pixel(i, j - 1), s.b.get_pixel(i, j - 1));
+         }},
+        {"g[:, :-1] = g[:, 1:] - c[:, :-1]",
+         [](Operands &o) {
+             (o.g.view(0, 1, HEIGHT, WIDTH - 1) - o.c.view(0, 0, HEIGHT, WIDTH - 1))
+                 .evaluate_into(o.g.view(0, 0, HEIGHT, WIDTH - 1));
+         },
+         [](S s, int i, int j) {
+             return j == WIDTH - 1 ? s.g.get_pixel(i, j) : sub(s.g.get_pixel(i, j + 1), s.c.get_pixel(i, j));
+         }},
+        {"g[1:, :] = b[:-1, :] + g[:-1, :]",
+         [](Operands &o) {
+             (o.b.view(0, 0, HEIGHT - 1, WIDTH) + o.g.view(0, 0, HEIGHT - 1, WIDTH))
+                 .evaluate_into(o.g.view(1, 0, HEIGHT - 1, WIDTH));
+         },
+         [](S s, int i, int j) {
+             return i == 0 ? s.g.get_pixel(i, j) : add(s.b.get_pixel(i - 1, j), s.g.get_pixel(i - 1, j));
+         }},
+        {"g[1:, 1:] = g[:-1, :-1] - (b[1:, 1:] + g[1:, :-1])",
+         [](Operands &o) {
+             (o.g.view(0, 0, HEIGHT - 1, WIDTH - 1) -
+              (o.b.view(1, 1, HEIGHT - 1, WIDTH - 1) + o.g.view(1, 0, HEIGHT - 1, WIDTH - 1)))
+                 .evaluate_into(o.g.view(1, 1, HEIGHT - 1, WIDTH - 1));
+         },
+         [](S s, int i, int j) {
+             if (i == 0 || j == 0)
+             {
+                 return static_cast<int>(s.g.get_pixel(i, j));
+             }
+             return sub(s.g.get_pixel(i - 1, j - 1), add(s.b.get_pixel(i, j), s.g.get_pixel(i, j - 1)));
+         }},
+        // Disjoint rows of the same image
+        {"g[:11, :] = g[12:, :] + b[:11, :]",
+         [](Operands &o) {
+             (o.g.view(12, 0, 11, WIDTH) + o.b.view(0, 0, 11, WIDTH)).evaluate_into(o.g.view(0, 0, 11, WIDTH));
+         },
+         [](S s, int i, int j) {
+             return i >= 11 ? s.g.get_pixel(i, j) : add(s.g.get_pixel(i + 12, j), s.b.get_pixel(i, j));
+         }},
+    };
+    return cases;
+}
+
+// Random pixels, the same on every run; a third of them at 0 or 255 so that
+// the clamping is exercised
+static GrayscaleImage random_image(std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255), kind(0, 5);
+    GrayscaleImage image(WIDTH, HEIGHT);
+    for (int i = 0; i < HEIGHT; i++)
+    {
+        for (int j = 0; j < WIDTH; j++)
+        {
+            int k = kind(generator);
+            image.set_pixel(i, j, k == 0 ? 0 : (k == 1 ? 255 : pixel(generator)));
+        }
+    }
+    return image;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(23);
+    int failures = 0;
+    for (const ExpressionCase &expression : expression_cases())
+    {
+        Operands operands = {random_image(generator), random_image(generator), random_image(generator),
+                             random_image(generator)};
+        Operands before = operands;
+        expression.apply(operands);
+
+        long wrong = 0;
+        for (int i = 0; i < HEIGHT; i++)
+        {
+            for (int j = 0; j < WIDTH; j++)
+            {
+                wrong += operands.g.get_pixel(i, j) != expression.expected(before, i, j) ? 1 : 0;
+            }
+        }
+        if (wrong > 0 || !(operands.b == before.b) || !(operands.c == before.c) || !(operands.d == before.d))
+        {
+            std::cerr << "FAIL " << expression.name << ": " << wrong << " pixel(s) differ from the reference"
+                      << std::endl;
+            failures++;
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " expression(s) differ from the per-pixel reference" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "every aliased expression matches the per-pixel reference" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+// Checks the saturating add / subtract row kernels on every instruction set
+// against a scalar clamp: widths around the 16- and 32-byte vector widths
+// (so the vector loops and the scalar tails both run), rows starting at odd
+// offsets, and dst aliasing a, b or both. Bytes around dst must be left
+// alone. GrayscaleImage::add / subtract are also checked on views at odd
+// offsets into larger images.
+//
+// Usage: test_saturating_arithmetic <sample_io directory>
+
+#include "GrayscaleImage.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const int WIDTHS[] = {0, 1, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100, 257};
+
+// Start of each row within its buffer, so that no vector load is aligned
+static const int OFFSETS[] = {0, 1, 3, 13};
+
+// Which buffer dst is
+enum Aliasing
+{
+    ALIAS_NONE,
+    ALIAS_A,
+    ALIAS_B,
+    ALIAS_BOTH // a, b and dst are all the same row
+};
+
+static const Aliasing ALIASINGS[] = {ALIAS_NONE, ALIAS_A, ALIAS_B, ALIAS_BOTH};
+static const char *ALIASING_NAMES[] = {"separate dst", "dst == a", "dst == b", "dst == a == b"};
+
+// Bytes before and after each row that the kernels must not touch
+static const int GUARD = 40;
+static const uint8_t GUARD_VALUE = 0xA5;
+
+static int clamp_add(int x, int y)
+{
+    return std::min(255, x + y);
+}
+
+static int clamp_subtract(int x, int y)
+{
+    return std::max(0, x - y);
+}
+
+// Random pixels, the same on every run; a third of them at 0 or 255 so that
+// both clamps are reached
+static std::vector<uint8_t> random_row(int n, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255), kind(0, 5);
+    std::vector<uint8_t> row(n);
+    for (uint8_t &value : row)
+    {
+        int k = kind(generator);
+        value = static_cast<uint8_t>(k == 0 ? 0 : (k == 1 ? 255 : pixel(generator)));
+    }
+    return row;
+}
+
+// Runs one kernel on copies of a and b placed at offset inside guarded
+// buffers; true if dst holds the clamped values and the guards are intact
+static bool check_kernel(bool subtract, const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, int offset,
+                         Aliasing aliasing)
+{
+    int n = static_cast<int>(a.size());
+    std::vector<uint8_t> bufferA(n + offset + 2 * GUARD, GUARD_VALUE), bufferB(bufferA), bufferDst(bufferA);
+    uint8_t *rowA = bufferA.data() + GUARD + offset;
+    uint8_t *rowB = bufferB.data() + GUARD + offset;
+    std::copy(a.begin(), a.end(), rowA);
+    std::copy(b.begin(), b.end(), rowB);
+
+    uint8_t *dst = bufferDst.data() + GUARD + offset;
+    std::vector<uint8_t> *dstBuffer = &bufferDst;
+    if (aliasing == ALIAS_A)
+    {
+        dst = rowA;
+        dstBuffer = &bufferA;
+    }
+    else if (aliasing == ALIAS_B)
+    {
+        dst = rowB;
+        dstBuffer = &bufferB;
+    }
+    else if (aliasing == ALIAS_BOTH)
+    {
+        rowB = rowA;
+        dst = rowA;
+        dstBuffer = &bufferA;
+    }
+    const std::vector<uint8_t> &second = aliasing == ALIAS_BOTH ? a : b;
+
+    if (subtract)
+    {
+        Simd::saturating_subtract_row(rowA, rowB, dst, n);
+    }
+    else
+    {
+        Simd::saturating_add_row(rowA, rowB, dst, n);
+    }
+
+    for (int j = 0; j < n; j++)
+    {
+        int expected = subtract ? clamp_subtract(a[j], second[j]) : clamp_add(a[j], second[j]);
+        if (dst[j] != expected)
+        {
+            return false;
+        }
+    }
+    const std::vector<uint8_t> &buffer = *dstBuffer;
+    for (int k = 0; k < GUARD + offset; k++)
+    {
+        if (buffer[k] != GUARD_VALUE)
+        {
+            return false;
+        }
+    }
+    for (size_t k = GUARD + offset + n; k < buffer.size(); k++)
+    {
+        if (buffer[k] != GUARD_VALUE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static GrayscaleImage random_image(int width, int height, std::mt19937 &generator)
+{
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        std::vector<uint8_t> row = random_row(width, generator);
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, row[j]);
+        }
+    }
+    return image;
+}
+
+// GrayscaleImage::add / subtract on w x h views at (row, col) of two images,
+// written to a view of a third; everything outside the result view must be
+// left alone
+static bool check_views(bool subtract, int w, int h, int row, int col, std::mt19937 &generator)
+{
+    const int width = w + col + 5, height = h + row + 2;
+    GrayscaleImage a = random_image(width, height, generator);
+    GrayscaleImage b = random_image(width, height, generator);
+    GrayscaleImage result = random_image(width, height, generator);
+    GrayscaleImage before = result;
+
+    // Read b one row and column further in than a, so the operands are not
+    // at the same place in their images
+    if (subtract)
+    {
+        GrayscaleImage::subtract(a.view(row, col, h, w), b.view(row + 1, col + 1, h, w),
+                                 result.view(row, col, h, w));
+    }
+    else
+    {
+        GrayscaleImage::add(a.view(row, col, h, w), b.view(row + 1, col + 1, h, w), result.view(row, col, h, w));
+    }
+
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int expected = before.get_pixel(i, j);
+            if (i >= row && i < row + h && j >= col && j < col + w)
+            {
+                int x = a.get_pixel(i, j), y = b.get_pixel(i + 1, j + 1);
+                expected = subtract ? clamp_subtract(x, y) : clamp_add(x, y);
+            }
+            if (result.get_pixel(i, j) != expected)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Simd::Level widest = Simd::detect_level();
+    std::mt19937 generator(22);
+    int failures = 0;
+    for (int level = Simd::SCALAR; level <= widest; level++)
+    {
+        Simd::set_level(static_cast<Simd::Level>(level));
+        std::string levelName = Simd::level_name(Simd::active_level());
+        for (int subtract = 0; subtract < 2; subtract++)
+        {
+            const char *operation = subtract ? "subtract" : "add";
+            for (int n : WIDTHS)
+            {
+                std::vector<uint8_t> a = random_row(n, generator);
+                std::vector<uint8_t> b = random_row(n, generator);
+                for (int offset : OFFSETS)
+                {
+                    for (int k = 0; k < 4; k++)
+                    {
+                        if (!check_kernel(subtract != 0, a, b, offset, ALIASINGS[k]))
+                        {
+                            std::cerr << "FAIL " << levelName << " saturating " << operation << ", width " << n
+                                      << ", offset " << offset << ", " << ALIASING_NAMES[k] << std::endl;
+                            failures++;
+                        }
+                    }
+                }
+            }
+
+            for (int w : {1, 17, 33, 70})
+            {
+                if (!check_views(subtract != 0, w, 3, 1, 3, generator))
+                {
+                    std::cerr << "FAIL " << levelName << " GrayscaleImage::" << operation << " on " << w
+                              << "x3 views at odd offsets" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    Simd::set_level(widest);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " saturating arithmetic check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "saturating add and subtract match the scalar clamp on every instruction set" << std::endl;
+    return EXIT_SUCCESS;
+}
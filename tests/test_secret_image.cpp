@@ -0,0 +1,111 @@
+// Round-trips SecretImage through save_to_file / load_from_file, the copy
+// constructor and reconstruct, on square, wide and tall images. The triangular
+// arrays of a non-square image are not width*(width+1)/2 and width*(width-1)/2
+// long, so build with -fsanitize=address to catch reads or writes past them.
+//
+// Usage: test_secret_image <sample_io directory>
+
+#include "GrayscaleImage.h"
+#include "SecretImage.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+struct ImageSize
+{
+    int width;
+    int height;
+};
+
+static const ImageSize SIZES[] = {{1, 1}, {7, 7}, {120, 50}, {50, 120}, {1, 9}, {9, 1}, {33, 32}};
+
+// Scratch file written next to the test binary
+static const char *SECRET_FILE = "test_secret_image.dat";
+
+// Random pixels, the same on every run
+static GrayscaleImage random_image(int width, int height, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> pixel(0, 255);
+    GrayscaleImage image(width, height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            image.set_pixel(i, j, static_cast<uint8_t>(pixel(generator)));
+        }
+    }
+    return image;
+}
+
+static bool check(const GrayscaleImage &expected, const GrayscaleImage &actual, const ImageSize &size,
+                  const char *step)
+{
+    if (actual.get_width() != expected.get_width() || actual.get_height() != expected.get_height() ||
+        !(actual == expected))
+    {
+        std::cerr << "FAIL " << size.width << "x" << size.height << ": " << step
+                  << " does not give back the original image" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample_io directory>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(4);
+    int failures = 0;
+    for (const ImageSize &size : SIZES)
+    {
+        GrayscaleImage original = random_image(size.width, size.height, generator);
+        SecretImage secret(original);
+        if (!check(original, secret.reconstruct(), size, "reconstruct"))
+        {
+            failures++;
+        }
+
+        secret.save_to_file(SECRET_FILE);
+        SecretImage loaded = SecretImage::load_from_file(SECRET_FILE);
+        if (loaded.get_width() != size.width || loaded.get_height() != size.height)
+        {
+            std::cerr << "FAIL " << size.width << "x" << size.height << ": loaded as " << loaded.get_width() << "x"
+                      << loaded.get_height() << std::endl;
+            failures++;
+            continue;
+        }
+        if (!check(original, loaded.reconstruct(), size, "save_to_file / load_from_file"))
+        {
+            failures++;
+        }
+
+        SecretImage copy(loaded);
+        if (!check(original, copy.reconstruct(), size, "copy constructor"))
+        {
+            failures++;
+        }
+
+        // save_back re-splits a changed image of the same size
+        GrayscaleImage changed = random_image(size.width, size.height, generator);
+        copy.save_back(changed);
+        if (!check(changed, copy.reconstruct(), size, "save_back"))
+        {
+            failures++;
+        }
+    }
+    std::remove(SECRET_FILE);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " round trip(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "SecretImage round trips on every size" << std::endl;
+    return EXIT_SUCCESS;
+}